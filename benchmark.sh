@@ -0,0 +1,9 @@
+# Count the instructions a program executes with the optimizer off and on.
+# Usage: ./benchmark.sh [program] [input], after building plum with build.sh.
+program=${1:-examples/invariant_loops.plo}
+input=${2:-20}
+for level in -O0 -O1; do
+    ./plum compile "$program" -o benchmark.plc $level > /dev/null || exit 1
+    echo "$level: $(echo "$input" | ./plum execute benchmark.plc --trace-cpu | grep -cE '^[A-Z]{3} ') instructions executed"
+done
+rm -f benchmark.plc
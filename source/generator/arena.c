@@ -0,0 +1,82 @@
+// Part of Plum by Tiger Sachse.
+
+#include <stdlib.h>
+#include "generator.h"
+
+// Create an empty arena. Its first block is only allocated once something is
+// taken from it.
+Arena *createArena(void) {
+    Arena *arena;
+
+    if ((arena = calloc(1, sizeof(Arena))) == NULL) {
+        printError(ERROR_OUT_OF_MEMORY);
+    }
+
+    return arena;
+}
+
+// Take size bytes of zeroed memory from the arena. Nothing taken from an arena
+// is freed on its own; it all goes at once in destroyArena().
+void *allocateFromArena(Arena *arena, size_t size) {
+    void *memory;
+    size_t blockSize;
+    ArenaBlock *block;
+
+    if (arena == NULL) {
+        printError(ERROR_NULL_POINTER);
+
+        return NULL;
+    }
+
+    // Keep every allocation aligned for any type.
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t) (ARENA_ALIGNMENT - 1);
+
+    // If the current block is out of room, start a new one. Requests bigger
+    // than a whole block get a block of their own, which goes behind the
+    // current block so that the rest of it can still be used.
+    block = arena->head;
+    if (block == NULL || block->size - block->used < size) {
+        blockSize = (size > ARENA_BLOCK_SIZE) ? size : ARENA_BLOCK_SIZE;
+        if ((block = calloc(1, sizeof(ArenaBlock) + blockSize)) == NULL) {
+            printError(ERROR_OUT_OF_MEMORY);
+
+            return NULL;
+        }
+
+        block->size = blockSize;
+        if (arena->head != NULL && blockSize > ARENA_BLOCK_SIZE) {
+            block->next = arena->head->next;
+            arena->head->next = block;
+        }
+        else {
+            block->next = arena->head;
+            arena->head = block;
+        }
+        arena->blocks++;
+    }
+
+    memory = (unsigned char*) block->data + block->used;
+    block->used += size;
+    arena->allocations++;
+
+    return memory;
+}
+
+// Free an arena and everything that was taken from it.
+void destroyArena(Arena *arena) {
+    ArenaBlock *next;
+    ArenaBlock *current;
+
+    if (arena == NULL) {
+        return;
+    }
+
+    current = arena->head;
+    while (current != NULL) {
+        next = current->next;
+        free(current);
+        current = next;
+    }
+
+    free(arena);
+}
@@ -39,16 +39,15 @@ int classProgram(IOTunnel *tunnel, SymbolTable *table) {
         setInstruction(&instruction, SIO, 0, 0, 3);
 
         // Return whether the final emit call is successful.
-        return emitInstruction(tunnel, instruction, 0);
+        return emitInstruction(tunnel, instruction);
     }
 }
 
 // Syntactic class for a block.
 // EBNF: [subclassConstDeclaration][subclassVarDeclaration][classStatement].
 int classBlock(IOTunnel *tunnel, SymbolTable *table) {
-    int value;
+    int allocation;
     Instruction instruction;
-    char identifier[IDENTIFIER_LEN + 1];
     
     if (tunnel == NULL || table == NULL) {
         printError(ERROR_NULL_POINTER);
@@ -70,28 +69,31 @@ int classBlock(IOTunnel *tunnel, SymbolTable *table) {
         }
     }
    
-    // Allocate the correct number of constants and variables on the stack.
-    setInstruction(&instruction, INC, 0, 0, getTableSize(table) + INT_OFFSET);
-    if (emitInstruction(tunnel, instruction, 0) == SIGNAL_FAILURE) {
+    // Allocate the correct number of variables on the stack. Constants need
+    // no room, as they are emitted as literals wherever they are used. Values
+    // spilled out of the registers are kept just past the variables, in slots
+    // that are added to the INC once the statements are done.
+    allocation = tunnel->programCounter;
+    tunnel->spillBase = table->currentAddress;
+    setInstruction(&instruction, INC, 0, 0, table->currentAddress);
+    if (emitInstruction(tunnel, instruction) == SIGNAL_FAILURE) {
         return SIGNAL_FAILURE;
     }
 
-    // Emit all the instructions to load constants into the stack.
-    if (setConstants(tunnel, table) == SIGNAL_FAILURE) {
+    // Handle all statements.
+    if (classStatement(tunnel, table) == SIGNAL_FAILURE) {
         return SIGNAL_FAILURE;
     }
-    
-    // Handle all statements.
-    return classStatement(tunnel, table, 0);
+
+    tunnel->code[allocation].MField += tunnel->spillSlots;
+
+    return SIGNAL_SUCCESS;
 }
 
 // Syntactic class for statements.
 // EBNF: [subclassIdentifierStatement | subclassBeginStatement | subclassIfStatement |
 //        subclassWhileStatement | subclassReadStatement | subclassWriteStatement].
-int classStatement(IOTunnel *tunnel, SymbolTable *table, int nestedDepth) {
-    Symbol *symbol;
-    Instruction instruction;
-
+int classStatement(IOTunnel *tunnel, SymbolTable *table) {
     if (tunnel == NULL || table == NULL) {
         printError(ERROR_NULL_POINTER);
 
@@ -100,50 +102,32 @@ int classStatement(IOTunnel *tunnel, SymbolTable *table, int nestedDepth) {
 
     // Handle identifier statements.
     if (tunnel->token == LEX_IDENTIFIER) {
-
-        // If the symbol is not in the symbol table, throw an error.
-        if ((symbol = lookupSymbol(table, tunnel->tokenName)) == NULL) {
-            printError(ERROR_UNDECLARED_IDENTIFIER);
-            
-            return SIGNAL_FAILURE;
-        }
-        
-        // Call the identifier subclass.
-        if (subclassIdentifierStatement(tunnel, table, nestedDepth) == SIGNAL_FAILURE) {
-            return SIGNAL_FAILURE;
-        }
-
-        // Store the calculated value for the identifier into the stack with a STO
-        // command. The calculated value will always be in register zero at this point.
-        setInstruction(&instruction, STO, 0, 0, symbol->address);
-        if (emitInstruction(tunnel, instruction, nestedDepth) == SIGNAL_FAILURE) {
-            return SIGNAL_FAILURE;
-        }
+        return subclassIdentifierStatement(tunnel, table);
     }
 
     // Handle begin/end multiline statements.
     else if (tunnel->token == LEX_BEGIN) {
-        return subclassBeginStatement(tunnel, table, nestedDepth);
+        return subclassBeginStatement(tunnel, table);
     }
 
     // Handle if statements.
     else if (tunnel->token == LEX_IF) {
-        return subclassIfStatement(tunnel, table, nestedDepth); 
+        return subclassIfStatement(tunnel, table); 
     }
 
     // Handle while statements.
     else if (tunnel->token == LEX_WHILE) {
-        return subclassWhileStatement(tunnel, table, nestedDepth);
+        return subclassWhileStatement(tunnel, table);
     }
 
     // Handle read statements.
     else if (tunnel->token == LEX_READ) {
-        return subclassReadStatement(tunnel, table, nestedDepth);
+        return subclassReadStatement(tunnel, table);
     }
 
     // Handle write statements.
     else if (tunnel->token == LEX_WRITE) {
-        return subclassWriteStatement(tunnel, table, nestedDepth);
+        return subclassWriteStatement(tunnel, table);
     }
 
     // Else this is the empty string.
@@ -154,7 +138,7 @@ int classStatement(IOTunnel *tunnel, SymbolTable *table, int nestedDepth) {
 
 // Syntactic class for conditions.
 // EBNF: "odd" classExpression | expression comparator expression.
-int classCondition(IOTunnel *tunnel, SymbolTable *table, int nestedDepth) {
+int classCondition(IOTunnel *tunnel, SymbolTable *table) {
     Instruction instruction;
     
     if (tunnel == NULL || table == NULL) {
@@ -169,7 +153,7 @@ int classCondition(IOTunnel *tunnel, SymbolTable *table, int nestedDepth) {
             return SIGNAL_FAILURE;
         }
 
-        if (classExpression(tunnel, table, 0, nestedDepth) == SIGNAL_FAILURE) {
+        if (emitExpression(tunnel, table, 0) == SIGNAL_FAILURE) {
             return SIGNAL_FAILURE;
         }
     }
@@ -178,7 +162,7 @@ int classCondition(IOTunnel *tunnel, SymbolTable *table, int nestedDepth) {
     else {
 
         // Get the left half of the condition.
-        if (classExpression(tunnel, table, 0, nestedDepth) == SIGNAL_FAILURE) {
+        if (emitExpression(tunnel, table, 0) == SIGNAL_FAILURE) {
             return SIGNAL_FAILURE;
         }
       
@@ -219,13 +203,13 @@ int classCondition(IOTunnel *tunnel, SymbolTable *table, int nestedDepth) {
         }
 
         // Get the right half of the condition.
-        if (classExpression(tunnel, table, 1, nestedDepth) == SIGNAL_FAILURE) {
+        if (emitExpression(tunnel, table, 1) == SIGNAL_FAILURE) {
             return SIGNAL_FAILURE;
         }
 
         // Emit the appropriate comparison instruction, determined by the switch
         // case above.
-        if (emitInstruction(tunnel, instruction, nestedDepth) == SIGNAL_FAILURE) {
+        if (emitInstruction(tunnel, instruction) == SIGNAL_FAILURE) {
             return SIGNAL_FAILURE;
         }
     }
@@ -233,25 +217,18 @@ int classCondition(IOTunnel *tunnel, SymbolTable *table, int nestedDepth) {
     return SIGNAL_SUCCESS;
 }
 
-// Syntactic class for expressions.
+// Syntactic class for expressions. Builds the expression's tree in node.
 // EBNF: ["+" | "-"] classTerm {("+" | "-") classTerm}.
-int classExpression(IOTunnel *tunnel, SymbolTable *table, int registerPosition, int nestedDepth) {
+int classExpression(IOTunnel *tunnel, SymbolTable *table, ExpressionNode **node) {
     int operation;
-    Instruction instruction;
+    ExpressionNode *term;
 
-    if (tunnel == NULL || table == NULL) {
+    if (tunnel == NULL || table == NULL || node == NULL) {
         printError(ERROR_NULL_POINTER);
 
         return SIGNAL_FAILURE;
     }
 
-    // Prevent attempts to use more registers than available.
-    if (registerPosition >= REGISTER_COUNT) {
-        printError(ERROR_REGISTER_OUT_OF_BOUNDS, registerPosition);
-        
-        return SIGNAL_FAILURE;
-    }
-
     // Accept positive or negative signs in front of terms.
     operation = tunnel->token;
     if (operation == LEX_PLUS || operation == LEX_MINUS) {
@@ -261,14 +238,13 @@ int classExpression(IOTunnel *tunnel, SymbolTable *table, int registerPosition,
     }
 
     // Get the first term of the expression.
-    if (classTerm(tunnel, table, registerPosition, nestedDepth) == SIGNAL_FAILURE) {
+    if (classTerm(tunnel, table, node) == SIGNAL_FAILURE) {
         return SIGNAL_FAILURE;
     }
 
     // Negate the term if there was a minus sign.
-    setInstruction(&instruction, NEG, registerPosition, registerPosition, 0);
     if (operation == LEX_MINUS) {
-        if (emitInstruction(tunnel, instruction, nestedDepth) == SIGNAL_FAILURE) {
+        if ((*node = createExpressionNode(tunnel, NEG, 0, *node, NULL)) == NULL) {
             return SIGNAL_FAILURE;
         }
     }
@@ -281,18 +257,18 @@ int classExpression(IOTunnel *tunnel, SymbolTable *table, int registerPosition,
             return SIGNAL_FAILURE;
         }
 
-        // Find the next term and save in the register adjacent the current register.
-        if (classTerm(tunnel, table, registerPosition + 1, nestedDepth) == SIGNAL_FAILURE) {
+        // Find the next term.
+        if (classTerm(tunnel, table, &term) == SIGNAL_FAILURE) {
             return SIGNAL_FAILURE;
         }
       
-        // Set up the instruction to add/subtract the adjacent register to the current one.
-        setInstruction(&instruction,
-                       (operation == LEX_PLUS) ? ADD : SUB,
-                       registerPosition,
-                       registerPosition,
-                       registerPosition + 1);
-        if (emitInstruction(tunnel, instruction, nestedDepth) == SIGNAL_FAILURE) {
+        // Add/subtract the next term to everything before it.
+        *node = createExpressionNode(tunnel,
+                                     (operation == LEX_PLUS) ? ADD : SUB,
+                                     0,
+                                     *node,
+                                     term);
+        if (*node == NULL) {
             return SIGNAL_FAILURE;
         }
 
@@ -303,27 +279,20 @@ int classExpression(IOTunnel *tunnel, SymbolTable *table, int registerPosition,
     return SIGNAL_SUCCESS;
 }
 
-// Syntactic class for terms.
+// Syntactic class for terms. Builds the term's tree in node.
 // EBNF: classFactor {("*" | "/") classFactor}.
-int classTerm(IOTunnel *tunnel, SymbolTable *table, int registerPosition, int nestedDepth) {
+int classTerm(IOTunnel *tunnel, SymbolTable *table, ExpressionNode **node) {
     int operation;
-    Instruction instruction;
+    ExpressionNode *factor;
 
-    if (tunnel == NULL || table == NULL) {
+    if (tunnel == NULL || table == NULL || node == NULL) {
         printError(ERROR_NULL_POINTER);
 
         return SIGNAL_FAILURE;
     }
    
-    // Prevent attempts to use more registers than available.
-    if (registerPosition >= REGISTER_COUNT) {
-        printError(ERROR_REGISTER_OUT_OF_BOUNDS, registerPosition);
-        
-        return SIGNAL_FAILURE;
-    }
-
     // Get the factor of this term.
-    if (classFactor(tunnel, table, registerPosition, nestedDepth) == SIGNAL_FAILURE) {
+    if (classFactor(tunnel, table, node) == SIGNAL_FAILURE) {
         return SIGNAL_FAILURE;
     }
    
@@ -334,19 +303,18 @@ int classTerm(IOTunnel *tunnel, SymbolTable *table, int registerPosition, int ne
             return SIGNAL_FAILURE;
         }
 
-        // Get the next factor and save it into the next adjacent register.
-        if (classFactor(tunnel, table, registerPosition + 1, nestedDepth) == SIGNAL_FAILURE) {
+        // Get the next factor.
+        if (classFactor(tunnel, table, &factor) == SIGNAL_FAILURE) {
             return SIGNAL_FAILURE;
         }
 
-        // Add the instruction to either multiply or divide the adjacent register
-        // with the current one.
-        setInstruction(&instruction,
-                       (operation == LEX_MULTIPLY) ? MUL : DIV,
-                       registerPosition,
-                       registerPosition,
-                       registerPosition + 1);
-        if (emitInstruction(tunnel, instruction, nestedDepth) == SIGNAL_FAILURE) {
+        // Multiply or divide everything before it by the next factor.
+        *node = createExpressionNode(tunnel,
+                                     (operation == LEX_MULTIPLY) ? MUL : DIV,
+                                     0,
+                                     *node,
+                                     factor);
+        if (*node == NULL) {
             return SIGNAL_FAILURE;
         }
 
@@ -356,38 +324,36 @@ int classTerm(IOTunnel *tunnel, SymbolTable *table, int registerPosition, int ne
     return SIGNAL_SUCCESS;
 }
 
-// Syntactic class for factors.
+// Syntactic class for factors. Builds the factor's tree in node.
 // EBNF: identifier | number | "(" classExpression ")".
-int classFactor(IOTunnel *tunnel, SymbolTable *table, int registerPosition, int nestedDepth) {
+int classFactor(IOTunnel *tunnel, SymbolTable *table, ExpressionNode **node) {
     Symbol *symbol;
-    Instruction instruction;
     
-    if (tunnel == NULL || table == NULL) {
+    if (tunnel == NULL || table == NULL || node == NULL) {
         printError(ERROR_NULL_POINTER);
 
         return SIGNAL_FAILURE;
     }
 
-    // Prevent attempts to use more registers than available.
-    if (registerPosition >= REGISTER_COUNT) {
-        printError(ERROR_REGISTER_OUT_OF_BOUNDS, registerPosition);
-        
-        return SIGNAL_FAILURE;
-    }
-
     // Factors can either be identifiers, numbers, or expressions.
     if (tunnel->token == LEX_IDENTIFIER) {
 
         // If the identifier is not in the symbol table, then it is undeclared.
         if ((symbol = lookupSymbol(table, tunnel->tokenName)) == NULL) {
-            printError(ERROR_UNDECLARED_IDENTIFIER, tunnel->tokenName);
+            printError(ERROR_UNDECLARED_IDENTIFIER, getTokenName(tunnel));
             
             return SIGNAL_FAILURE;
         }
        
-        // Load the value of the identifier into the current register.
-        setInstruction(&instruction, LOD, registerPosition, 0, symbol->address);
-        if (emitInstruction(tunnel, instruction, nestedDepth) == SIGNAL_FAILURE) {
+        // Constants are used as literals, and variables are loaded from their
+        // addresses.
+        if (symbol->type == LEX_CONST) {
+            *node = createExpressionNode(tunnel, LIT, symbol->value, NULL, NULL);
+        }
+        else {
+            *node = createExpressionNode(tunnel, LOD, symbol->address, NULL, NULL);
+        }
+        if (*node == NULL) {
             return SIGNAL_FAILURE;
         }
         
@@ -397,9 +363,8 @@ int classFactor(IOTunnel *tunnel, SymbolTable *table, int registerPosition, int
     }
     else if (tunnel->token == LEX_NUMBER) {
 
-        // Load a literal into the current register.
-        setInstruction(&instruction, LIT, registerPosition, 0, tunnel->tokenValue);
-        if (emitInstruction(tunnel, instruction, nestedDepth) == SIGNAL_FAILURE) {
+        // Numbers are loaded as literals.
+        if ((*node = createExpressionNode(tunnel, LIT, tunnel->tokenValue, NULL, NULL)) == NULL) {
             return SIGNAL_FAILURE;
         }
         
@@ -413,7 +378,7 @@ int classFactor(IOTunnel *tunnel, SymbolTable *table, int registerPosition, int
         }
 
         // Call expression for the contents of the parenthetic expression.
-        if (classExpression(tunnel, table, registerPosition, nestedDepth) == SIGNAL_FAILURE) {
+        if (classExpression(tunnel, table, node) == SIGNAL_FAILURE) {
             return SIGNAL_FAILURE;
         }
 
@@ -440,8 +405,7 @@ int classFactor(IOTunnel *tunnel, SymbolTable *table, int registerPosition, int
 // Subclass for constant declarations.
 // EBNF: "const" identifier "=" number {"," identifier "=" number} ";".
 int subclassConstDeclaration(IOTunnel *tunnel, SymbolTable *table) {
-    int value;
-    char identifier[IDENTIFIER_LEN + 1];
+    int identifier;
     
     if (tunnel == NULL || table == NULL) {
         printError(ERROR_NULL_POINTER);
@@ -463,7 +427,7 @@ int subclassConstDeclaration(IOTunnel *tunnel, SymbolTable *table) {
         }
 
         // Save the identifier's name for later.
-        strcpy(identifier, tunnel->tokenName);
+        identifier = tunnel->tokenName;
 
         if (loadToken(tunnel) == SIGNAL_FAILURE) {
             return SIGNAL_FAILURE;
@@ -490,7 +454,7 @@ int subclassConstDeclaration(IOTunnel *tunnel, SymbolTable *table) {
         // Put the constant into the symbol table.
         if (insertSymbol(table,
                          LEX_CONST,
-                         tunnel->tokenValue, 0,
+                         tunnel->tokenValue, table->level,
                          STATUS_ACTIVE,
                          identifier) == SIGNAL_FAILURE) {
             
@@ -540,7 +504,7 @@ int subclassVarDeclaration(IOTunnel *tunnel, SymbolTable *table) {
         }
 
         // Attempt to insert the variable into the table.
-        if (insertSymbol(table, LEX_VAR, 0, 0,
+        if (insertSymbol(table, LEX_VAR, 0, table->level,
                          STATUS_ACTIVE, tunnel->tokenName) == SIGNAL_FAILURE) {
             
             return SIGNAL_FAILURE;
@@ -568,8 +532,9 @@ int subclassVarDeclaration(IOTunnel *tunnel, SymbolTable *table) {
 
 // Subclass for identifier statements.
 // EBNF: identifier ":=" classExpression.
-int subclassIdentifierStatement(IOTunnel *tunnel, SymbolTable *table, int nestedDepth) {
+int subclassIdentifierStatement(IOTunnel *tunnel, SymbolTable *table) {
     Symbol *symbol;
+    Instruction instruction;
     
     if (tunnel == NULL || table == NULL) {
         printError(ERROR_NULL_POINTER);
@@ -579,13 +544,13 @@ int subclassIdentifierStatement(IOTunnel *tunnel, SymbolTable *table, int nested
 
     // Ensure that the identifier exists and is not a constant.
     if ((symbol = lookupSymbol(table, tunnel->tokenName)) == NULL) {
-        printError(ERROR_UNDECLARED_IDENTIFIER, tunnel->tokenName);
+        printError(ERROR_UNDECLARED_IDENTIFIER, getTokenName(tunnel));
 
         return SIGNAL_FAILURE;
     }
     else {
         if (symbol->type == LEX_CONST) {
-            printError(ERROR_ASSIGNMENT_TO_CONSTANT, symbol->name);
+            printError(ERROR_ASSIGNMENT_TO_CONSTANT, getInternedName(table->names, symbol->name));
 
             return SIGNAL_FAILURE;
         }
@@ -607,12 +572,20 @@ int subclassIdentifierStatement(IOTunnel *tunnel, SymbolTable *table, int nested
     }
 
     // Find the resulting expression for the identifier.
-    return classExpression(tunnel, table, 0, nestedDepth);
+    if (emitExpression(tunnel, table, 0) == SIGNAL_FAILURE) {
+        return SIGNAL_FAILURE;
+    }
+
+    // Store the calculated value for the identifier into the stack with a STO
+    // command. The calculated value will always be in register zero at this point.
+    setInstruction(&instruction, STO, 0, 0, symbol->address);
+
+    return emitInstruction(tunnel, instruction);
 }
 
 // Subclass for begin statements.
 // EBNF: "begin" classStatement {";" classStatement} "end".
-int subclassBeginStatement(IOTunnel *tunnel, SymbolTable *table, int nestedDepth) {
+int subclassBeginStatement(IOTunnel *tunnel, SymbolTable *table) {
     if (tunnel == NULL || table == NULL) {
         printError(ERROR_NULL_POINTER);
 
@@ -624,7 +597,7 @@ int subclassBeginStatement(IOTunnel *tunnel, SymbolTable *table, int nestedDepth
     }
 
     // Begin multiline statements have at least one statement.
-    if (classStatement(tunnel, table, nestedDepth) == SIGNAL_FAILURE) {
+    if (classStatement(tunnel, table) == SIGNAL_FAILURE) {
         return SIGNAL_FAILURE;
     }
 
@@ -634,7 +607,7 @@ int subclassBeginStatement(IOTunnel *tunnel, SymbolTable *table, int nestedDepth
             return SIGNAL_FAILURE;
         }
         
-        if (classStatement(tunnel, table, nestedDepth) == SIGNAL_FAILURE) {
+        if (classStatement(tunnel, table) == SIGNAL_FAILURE) {
             return SIGNAL_FAILURE;
         }
     }
@@ -655,10 +628,8 @@ int subclassBeginStatement(IOTunnel *tunnel, SymbolTable *table, int nestedDepth
 
 // Subclass for if statements.
 // EBNF: "if" classCondition "then" classStatement.
-int subclassIfStatement(IOTunnel *tunnel, SymbolTable *table, int nestedDepth) {
-    int jumpTarget;
-    Instruction instruction;
-    QueueNode *insertionPoint;
+int subclassIfStatement(IOTunnel *tunnel, SymbolTable *table) {
+    int jump;
 
     if (tunnel == NULL || table == NULL) {
         printError(ERROR_NULL_POINTER);
@@ -670,16 +641,15 @@ int subclassIfStatement(IOTunnel *tunnel, SymbolTable *table, int nestedDepth) {
         return SIGNAL_FAILURE;
     }
 
-    // Construct the condition for the if statement. This call increases the
-    // nested depth by one (thus insuring that any resulting instructions are 
-    // saved in the queue instead of printed to the file). Increasing the nestedDepth
-    // is also critical for nested if and while statements.
-    if (classCondition(tunnel, table, nestedDepth + 1) == SIGNAL_FAILURE) {
+    // Construct the condition for the if statement.
+    if (classCondition(tunnel, table) == SIGNAL_FAILURE) {
         return SIGNAL_FAILURE;
     }
 
-    // Get the insertion point in the instruction queue for the eventual JPC instruction.
-    if ((insertionPoint = getQueueTail(tunnel)) == NULL) {
+    // The condition is followed by a JPC that skips the statement when the
+    // condition is false. Where the statement ends isn't known yet, so the
+    // JPC is patched once it is.
+    if ((jump = emitJumpPlaceholder(tunnel, JPC)) == SIGNAL_FAILURE) {
         return SIGNAL_FAILURE;
     }
 
@@ -695,32 +665,22 @@ int subclassIfStatement(IOTunnel *tunnel, SymbolTable *table, int nestedDepth) {
     }
   
     // Get the if statement's statements.
-    if (classStatement(tunnel, table, nestedDepth + 1) == SIGNAL_FAILURE) {
+    if (classStatement(tunnel, table) == SIGNAL_FAILURE) {
         return SIGNAL_FAILURE;
     }
 
-    // Insert the JPC command at the insertionPoint in the instruction queue.
-    jumpTarget = tunnel->programCounter + getQueueSize(tunnel->queue) + nestedDepth + 1;
-    setInstruction(&instruction, JPC, 0, 0, jumpTarget);
-    if (insertInstruction(tunnel->queue, instruction, insertionPoint) == SIGNAL_FAILURE) {
-        return SIGNAL_FAILURE;
-    }
-   
-    // If we aren't nested anymore, emit all of the instructions in the instruction queue.
-    if (nestedDepth <= 0) {
-        emitInstructions(tunnel);
-    }
+    // Point the JPC just past the statement.
+    patchJumpTarget(tunnel, jump, markJumpTarget(tunnel));
 
     return SIGNAL_SUCCESS;
 }
 
 // Subclass for while statements.
 // EBNF: "while" classCondition "do" classStatement.
-int subclassWhileStatement(IOTunnel *tunnel, SymbolTable *table, int nestedDepth) {
-    int jumpTarget;
+int subclassWhileStatement(IOTunnel *tunnel, SymbolTable *table) {
+    int jump;
     int returnTarget;
     Instruction instruction;
-    QueueNode *insertionPoint;
 
     if (tunnel == NULL || table == NULL) {
         printError(ERROR_NULL_POINTER);
@@ -734,15 +694,15 @@ int subclassWhileStatement(IOTunnel *tunnel, SymbolTable *table, int nestedDepth
 
     // Save the return target for the JMP command that will be inserted at the
     // bottom of the while statement.
-    returnTarget = tunnel->programCounter + getQueueSize(tunnel->queue) + nestedDepth;
+    returnTarget = markJumpTarget(tunnel);
 
     // Get the while statement's condition.
-    if (classCondition(tunnel, table, nestedDepth + 1) == SIGNAL_FAILURE) {
+    if (classCondition(tunnel, table) == SIGNAL_FAILURE) {
         return SIGNAL_FAILURE;
     }
 
-    // Save the insertion point for the JPC command that controls the loop.
-    if ((insertionPoint = getQueueTail(tunnel)) == NULL) {
+    // The JPC that leaves the loop is patched once the end of the loop is known.
+    if ((jump = emitJumpPlaceholder(tunnel, JPC)) == SIGNAL_FAILURE) {
         return SIGNAL_FAILURE;
     }
 
@@ -758,35 +718,26 @@ int subclassWhileStatement(IOTunnel *tunnel, SymbolTable *table, int nestedDepth
     }
 
     // Get the while statement's statements.
-    if (classStatement(tunnel, table, nestedDepth + 1) == SIGNAL_FAILURE) {
+    if (classStatement(tunnel, table) == SIGNAL_FAILURE) {
         return SIGNAL_FAILURE;
     }
 
     // Add the jump instruction at the bottom of all the statements to go
     // back to the top of the loop.
     setInstruction(&instruction, JMP, 0, 0, returnTarget);
-    if (emitInstruction(tunnel, instruction, nestedDepth + 1) == SIGNAL_FAILURE) {
+    if (emitInstruction(tunnel, instruction) == SIGNAL_FAILURE) {
         return SIGNAL_FAILURE;
     }
 
-    // Insert the JPC command at the insertion point.
-    jumpTarget = tunnel->programCounter + getQueueSize(tunnel->queue) + nestedDepth + 1;
-    setInstruction(&instruction, JPC, 0, 0, jumpTarget);
-    if (insertInstruction(tunnel->queue, instruction, insertionPoint) == SIGNAL_FAILURE) {
-        return SIGNAL_FAILURE;
-    }
-    
-    // If we are not nested, emit all the instructions in the instruction queue.
-    if (nestedDepth <= 0) {
-        emitInstructions(tunnel);
-    }
+    // Point the JPC just past the loop.
+    patchJumpTarget(tunnel, jump, markJumpTarget(tunnel));
 
     return SIGNAL_SUCCESS;
 }
 
 // Subclass for read statements.
 // EBNF: "read" identifier.
-int subclassReadStatement(IOTunnel *tunnel, SymbolTable *table, int nestedDepth) {
+int subclassReadStatement(IOTunnel *tunnel, SymbolTable *table) {
     Symbol *symbol;
     Instruction instruction;
     
@@ -809,20 +760,27 @@ int subclassReadStatement(IOTunnel *tunnel, SymbolTable *table, int nestedDepth)
   
     // If the symbol is not in the table, read cannot proceed.
     if ((symbol = lookupSymbol(table, tunnel->tokenName)) == NULL) {
-        printError(ERROR_UNDECLARED_IDENTIFIER, tunnel->tokenName);
+        printError(ERROR_UNDECLARED_IDENTIFIER, getTokenName(tunnel));
+
+        return SIGNAL_FAILURE;
+    }
+
+    // Constants have no place in the stack to read into.
+    if (symbol->type == LEX_CONST) {
+        printError(ERROR_ASSIGNMENT_TO_CONSTANT, getInternedName(table->names, symbol->name));
 
         return SIGNAL_FAILURE;
     }
 
     // Create the read system call.
     setInstruction(&instruction, SIO, 0, 0, 2);
-    if (emitInstruction(tunnel, instruction, nestedDepth) == SIGNAL_FAILURE) {
+    if (emitInstruction(tunnel, instruction) == SIGNAL_FAILURE) {
         return SIGNAL_FAILURE;
     }
    
     // Store the read value into the appropriate place in the stack.
     setInstruction(&instruction, STO, 0, 0, symbol->address);
-    if (emitInstruction(tunnel, instruction, nestedDepth) == SIGNAL_FAILURE) {
+    if (emitInstruction(tunnel, instruction) == SIGNAL_FAILURE) {
         return SIGNAL_FAILURE;
     }
 
@@ -835,7 +793,7 @@ int subclassReadStatement(IOTunnel *tunnel, SymbolTable *table, int nestedDepth)
 
 // Subclass for write statements.
 // EBNF: "write" identifier.
-int subclassWriteStatement(IOTunnel *tunnel, SymbolTable *table, int nestedDepth) {
+int subclassWriteStatement(IOTunnel *tunnel, SymbolTable *table) {
     Symbol *symbol;
     Instruction instruction;
 
@@ -858,20 +816,26 @@ int subclassWriteStatement(IOTunnel *tunnel, SymbolTable *table, int nestedDepth
    
     // If the symbol is not in the symbol table, throw an error.
     if ((symbol = lookupSymbol(table, tunnel->tokenName)) == NULL) {
-        printError(ERROR_UNDECLARED_IDENTIFIER);
+        printError(ERROR_UNDECLARED_IDENTIFIER, getTokenName(tunnel));
         
         return SIGNAL_FAILURE;
     }
 
-    // Load the correct identifier into register zero.
-    setInstruction(&instruction, LOD, 0, 0, symbol->address);
-    if (emitInstruction(tunnel, instruction, nestedDepth) == SIGNAL_FAILURE) {
+    // Load the correct identifier into register zero. Constants are loaded
+    // as literals.
+    if (symbol->type == LEX_CONST) {
+        setInstruction(&instruction, LIT, 0, 0, symbol->value);
+    }
+    else {
+        setInstruction(&instruction, LOD, 0, 0, symbol->address);
+    }
+    if (emitInstruction(tunnel, instruction) == SIGNAL_FAILURE) {
         return SIGNAL_FAILURE;
     }
     
     // Create the system call to print register zero.
     setInstruction(&instruction, SIO, 0, 0, 1);
-    if (emitInstruction(tunnel, instruction, nestedDepth) == SIGNAL_FAILURE) {
+    if (emitInstruction(tunnel, instruction) == SIGNAL_FAILURE) {
         return SIGNAL_FAILURE;
     }
     
@@ -1,34 +1,162 @@
 // Part of Plum by Tiger Sachse.
 
+#include <stdlib.h>
+#include <string.h>
 #include "generator.h"
 
 // Compile lexemes from the lexemeFile into usable bytecode.
 int compileLexemes(char *lexemeFile, char *outFile, int options) {
     int returnValue;
+    int instructionCount;
+    LexemeList *lexemes;
+    Instruction *instructions;
+
+    // Load the lexeme file into memory.
+    if ((lexemes = loadLexemeList(lexemeFile)) == NULL) {
+        return SIGNAL_FAILURE;
+    }
+
+    // Generate the bytecode, then write it to the output file.
+    if ((instructions = generateInstructions(lexemes, &instructionCount, options)) == NULL) {
+        returnValue = SIGNAL_FAILURE;
+    }
+    else {
+        returnValue = writeInstructions(outFile, instructions, instructionCount, options);
+    }
+
+    // Stay memory safe.
+    free(instructions);
+    destroyLexemeList(lexemes);
+
+    return returnValue;
+}
+
+// Generate bytecode for the lexemes in memory. Returns the instructions, which
+// the caller must free, and stores their count in instructionCount. Every
+// other data structure of the compilation comes from one arena, which is
+// released at the end in a single call.
+Instruction *generateInstructions(LexemeList *lexemes, int *instructionCount, int options) {
+    int returnValue;
+    int statistics[IR_STATISTICS] = { 0 };
+    Arena *arena;
     IOTunnel *tunnel;
     SymbolTable *table;
+    Instruction *instructions;
 
-    // Create the symbol table.
-    if ((table = createSymbolTable()) == NULL) {
-        return SIGNAL_FAILURE;
+    if (lexemes == NULL || instructionCount == NULL) {
+        printError(ERROR_NULL_POINTER);
+
+        return NULL;
     }
-    
-    // Create the input/output tunnel.
-    if ((tunnel = createIOTunnel(lexemeFile, outFile)) == NULL) {
-        return SIGNAL_FAILURE;
+
+    if ((arena = createArena()) == NULL) {
+        return NULL;
+    }
+
+    // Create the symbol table, which shares the names of the lexemes, and
+    // the input/output tunnel.
+    if ((table = createSymbolTable(arena, lexemes->names)) == NULL ||
+        (tunnel = createIOTunnel(arena, lexemes)) == NULL) {
+
+        destroyArena(arena);
+
+        return NULL;
+    }
+
+    // Call the program class, optimizing the code as it is emitted if requested.
+    tunnel->optimize = checkOption(&options, OPTION_OPTIMIZE);
+    returnValue = classProgram(tunnel, table);
+
+    // Optimize the program as a whole, if requested.
+    if (returnValue == SIGNAL_SUCCESS && tunnel->optimize) {
+        returnValue = optimizeInstructions(tunnel, statistics);
     }
 
-    // Call the program class.
-    returnValue = classProgram(tunnel, table); 
-    
     // Print the symbol table, if requested.
     if (returnValue == SIGNAL_SUCCESS && checkOption(&options, OPTION_PRINT_SYMBOL_TABLE)) {
         printSymbolTable(table);
     }
 
+    // Print how often each optimization was applied, if requested.
+    if (returnValue == SIGNAL_SUCCESS && checkOption(&options, OPTION_PRINT_OPT_STATS)) {
+        printPeepholeReport(tunnel->peepholeHits);
+        printIRReport(statistics);
+    }
+
+    // Take the emitted code from the tunnel before it is destroyed.
+    instructions = NULL;
+    if (returnValue == SIGNAL_SUCCESS) {
+        instructions = tunnel->code;
+        *instructionCount = tunnel->programCounter;
+        tunnel->code = NULL;
+    }
+
     // Stay memory safe.
     destroyIOTunnel(tunnel);
-    destroySymbolTable(table);
+    destroyArena(arena);
 
-    return returnValue;
+    return instructions;
+}
+
+// Write instructions to outFile as text bytecode, or as binary bytecode if
+// requested in the options.
+int writeInstructions(char *outFile, Instruction *instructions, int instructionCount, int options) {
+    int i;
+    FILE *f;
+    int returnValue;
+    BytecodeHeader header;
+
+    if (outFile == NULL || instructions == NULL) {
+        printError(ERROR_NULL_POINTER);
+
+        return SIGNAL_FAILURE;
+    }
+
+    if ((f = fopen(outFile, "wb")) == NULL) {
+        printError(ERROR_FILE_NOT_FOUND, outFile);
+
+        return SIGNAL_FAILURE;
+    }
+
+    returnValue = SIGNAL_SUCCESS;
+
+    // Binary bytecode is a header followed by the instructions as they are.
+    if (checkOption(&options, OPTION_BINARY_BYTECODE)) {
+        memset(&header, 0, sizeof(BytecodeHeader));
+        memcpy(header.magic, BYTECODE_MAGIC, BYTECODE_MAGIC_LENGTH);
+        header.version = BYTECODE_VERSION;
+        header.instructionCount = instructionCount;
+        header.checksum = checksumInstructions(FNV_OFFSET_BASIS,
+                                               instructions,
+                                               instructionCount);
+        header.flags = getHostBytecodeFlags();
+
+        if (fwrite(&header, sizeof(BytecodeHeader), 1, f) != 1 ||
+            fwrite(instructions, sizeof(Instruction), instructionCount, f) != (size_t) instructionCount) {
+
+            returnValue = SIGNAL_FAILURE;
+        }
+    }
+
+    // Else each instruction is printed on its own line.
+    else {
+        for (i = 0; i < instructionCount && returnValue == SIGNAL_SUCCESS; i++) {
+            if (fprintf(f, "%d %d %d %d\n",
+                        instructions[i].opCode,
+                        instructions[i].RField,
+                        instructions[i].LField,
+                        instructions[i].MField) <= 0) {
+
+                returnValue = SIGNAL_FAILURE;
+            }
+        }
+    }
+
+    if (fclose(f) != 0 || returnValue == SIGNAL_FAILURE) {
+        printError(ERROR_WRITING_FILE_FAILED);
+
+        return SIGNAL_FAILURE;
+    }
+
+    return SIGNAL_SUCCESS;
 }
@@ -3,34 +3,170 @@
 #define GENERATOR_H
 
 #include <stdio.h>
+#include <stddef.h>
 #include <limits.h>
 #include "../plum.h"
 
-// Nodes for the instruction queue.
-typedef struct QueueNode {
-    Instruction instruction;
-    struct QueueNode *next;
-} QueueNode;
+#define INITIAL_CODE_CAPACITY 1024
+#define INITIAL_SYMBOL_CAPACITY 64
+#define NO_SYMBOL -1
+#define ARENA_BLOCK_SIZE 65536
+#define ARENA_ALIGNMENT 16
+#define PEEPHOLE_PATTERNS 5
+#define NO_REWRITE -1
+#define INITIAL_DEFINITION_CAPACITY 256
+#define NO_BLOCK -1
+#define NO_DEFINITION -1
+#define NO_INSTRUCTION -1
 
-// A queue of instructions for implementing if blocks.
-typedef struct InstructionQueue {
-    QueueNode *head;
-    QueueNode *tail;
-    int length;
-} InstructionQueue;
+// Counts of the changes made by the IR optimizer.
+enum IRStatistics {
+    IR_FOLDED_BRANCHES,
+    IR_UNREACHABLE_BLOCKS,
+    IR_DEAD_STORES,
+    IR_DEAD_INSTRUCTIONS,
+    IR_HOISTED_INVARIANTS,
+    IR_REMOVED_JUMPS,
+    IR_STATISTICS
+};
+
+// A block of memory in an arena. Allocations are bumped off the front of data.
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t size;
+    size_t used;
+    max_align_t data[];
+} ArenaBlock;
 
-// A tunnel for input and output streams, as well as token storage.
+// An arena that serves every data structure of a compilation, which are all
+// released together when it is destroyed.
+typedef struct Arena {
+    ArenaBlock *head;
+    long blocks;
+    long allocations;
+} Arena;
+
+// A tunnel from the lexeme list to the emitted code, as well as token storage.
 typedef struct IOTunnel {
     int token;
-    FILE *fin;
-    FILE *fout;
     int status;
     int tokenValue;
+    int lexemeIndex;
     int programCounter;
-    InstructionQueue *queue;
-    char tokenName[IDENTIFIER_LEN + 1];
+    int codeCapacity;
+    Instruction *code;
+    LexemeList *lexemes;
+    int tokenName;
+    int spillBase;
+    int spillSlots;
+    int optimize;
+    int barrier;
+    int peepholeHits[PEEPHOLE_PATTERNS];
+    Arena *arena;
 } IOTunnel;
 
+// A rewrite pattern for the peephole optimizer. The rewrite is given the last
+// length instructions emitted, and returns how many instructions it leaves in
+// their place, or NO_REWRITE if they don't match the pattern.
+typedef struct PeepholePattern {
+    char *name;
+    int length;
+    int (*rewrite)(Instruction*);
+} PeepholePattern;
+
+// Node in the tree of an expression. Expressions are parsed into a tree before
+// any of their code is emitted, so that registers can be given out in the
+// order that needs the fewest. Literals and identifiers are leaves with a LIT
+// or LOD opCode and a value or address, negations only have a left operand,
+// and all other nodes are arithmetic operations.
+typedef struct ExpressionNode {
+    int opCode;
+    int value;
+    int registers;
+    struct ExpressionNode *left;
+    struct ExpressionNode *right;
+} ExpressionNode;
+
+// An expression hoisted out of a loop: the instructions that compute it, and
+// the store of its value to a temporary, in the order they are run.
+typedef struct HoistedExpression {
+    Instruction *code;
+    int length;
+    struct HoistedExpression *next;
+} HoistedExpression;
+
+// A straight run of instructions that is only entered at the top and only
+// left at the bottom. Blocks are linked into a control flow graph by their
+// successors and predecessors, and into a dominator tree by their dominators
+// and children. Order is the block's place in reverse postorder, or NO_BLOCK
+// if it can't be reached. Loop is the header of the innermost loop the block
+// is in, and a header's parentLoop is the header of the loop around its own.
+// Expressions hoisted out of a loop are kept by its header, to be run before
+// the loop is entered.
+typedef struct BasicBlock {
+    int start;
+    int end;
+    int successors[2];
+    int successorCount;
+    int *predecessors;
+    int predecessorCount;
+    int order;
+    int dominator;
+    int *children;
+    int childCount;
+    int firstPhi;
+    int loop;
+    int parentLoop;
+    int loopDepth;
+    HoistedExpression *hoisted;
+} BasicBlock;
+
+// A definition of a variable in SSA form. It is either the store at
+// instruction, or a phi at the top of a block where several definitions meet,
+// with one operand per predecessor of the block. Either way, block is where it
+// is made. A variable's value on entry to the program is NO_DEFINITION.
+typedef struct Definition {
+    int variable;
+    int block;
+    int instruction;
+    int live;
+    int previous;
+    int *operands;
+    int operandCount;
+    int nextPhi;
+} Definition;
+
+// Node in a list of blocks or instructions.
+typedef struct ListNode {
+    int value;
+    struct ListNode *next;
+} ListNode;
+
+// The code of a program as basic blocks in a control flow graph, with its
+// variables in SSA form. Every load's entry in uses is the definition it
+// reads, and each instruction has two entries in sources for the instructions
+// that wrote the registers it reads. Instructions are marked as removed until
+// the graph is lowered.
+typedef struct ControlFlowGraph {
+    Instruction *code;
+    int count;
+    char *removed;
+    char *leader;
+    int *blockOf;
+    int *uses;
+    int *sources;
+    ListNode *exits[REGISTER_COUNT];
+    BasicBlock *blocks;
+    int blockCount;
+    int *order;
+    int reachable;
+    int variables;
+    Definition *definitions;
+    int definitionCount;
+    int definitionCapacity;
+    Arena *arena;
+} ControlFlowGraph;
+
 // Different statuses possible for symbols in the symbol table.
 enum Status {
     STATUS_ACTIVE,
@@ -44,73 +180,122 @@ typedef struct Symbol {
     int level;
     int active;
     int address;
-    char name[IDENTIFIER_LEN + 1];
+    int name;
+    int shadowed;
 } Symbol;
 
-// Node that represents a column in a symbol table.
-typedef struct TableNode {
-    Symbol symbol;
-    struct TableNode *next;
-} TableNode;
+// Slot in the symbol table's hash index. A slot belongs to a name for good
+// once it is taken, and holds the newest visible symbol with that name, or
+// NO_SYMBOL when its scope has been popped.
+typedef struct SymbolSlot {
+    int name;
+    int symbol;
+} SymbolSlot;
 
-// Symbol table container struct that implements a linked list.
+// Symbol table container struct. Symbols are kept in declaration order in an
+// array, and found by name through an open-addressed hash index that is kept
+// at most half full. Symbols are named by ids from the intern table of the
+// lexemes being compiled.
 typedef struct SymbolTable {
     int symbols;
+    int capacity;
     int currentAddress;
-    struct TableNode *head;
+    int level;
+    int mask;
+    Symbol *entries;
+    SymbolSlot *slots;
+    InternTable *names;
+    Arena *arena;
 } SymbolTable;
 
 // Generator functional prototypes.
 int compileLexemes(char*, char*, int);
+Instruction *generateInstructions(LexemeList*, int*, int);
+int writeInstructions(char*, Instruction*, int, int);
+
+// Arena functional prototypes.
+Arena *createArena(void);
+void *allocateFromArena(Arena*, size_t);
+void destroyArena(Arena*);
 
 // Tunnel functional prototypes.
-IOTunnel *createIOTunnel(char*, char*);
-int emitInstruction(IOTunnel*, Instruction, int);
-int emitInstructions(IOTunnel*);
-int setConstants(IOTunnel*, SymbolTable*);
-QueueNode *getQueueTail(IOTunnel*);
+IOTunnel *createIOTunnel(Arena*, LexemeList*);
+int emitInstruction(IOTunnel*, Instruction);
+int emitJumpPlaceholder(IOTunnel*, int);
+void patchJumpTarget(IOTunnel*, int, int);
+int markJumpTarget(IOTunnel*);
 int loadToken(IOTunnel*);
 int handleIdentifier(IOTunnel*);
 int handleNumber(IOTunnel*);
+char *getTokenName(IOTunnel*);
 void destroyIOTunnel(IOTunnel*);
 
 // Table functional prototypes.
-SymbolTable *createSymbolTable(void);
-TableNode *createTableNode(int, int, int, int, int, char*, TableNode*);
-int insertSymbol(SymbolTable*, int, int, int, int, char*);
-Symbol *lookupSymbol(SymbolTable*, char*);
-int getTableSize(SymbolTable*);
-void destroySymbolTable(SymbolTable*);
+SymbolTable *createSymbolTable(Arena*, InternTable*);
+SymbolSlot *findSymbolSlot(SymbolTable*, int);
+int growSymbolTable(SymbolTable*);
+int insertSymbol(SymbolTable*, int, int, int, int, int);
+Symbol *lookupSymbol(SymbolTable*, int);
+void pushScope(SymbolTable*);
+void popScope(SymbolTable*);
 
 // Class functional prototypes.
 int classProgram(IOTunnel*, SymbolTable*);
 int classBlock(IOTunnel*, SymbolTable*);
-int classStatement(IOTunnel*, SymbolTable*, int);
-int classCondition(IOTunnel*, SymbolTable*, int);
-int classExpression(IOTunnel*, SymbolTable*, int, int);
-int classTerm(IOTunnel*, SymbolTable*, int, int);
-int classFactor(IOTunnel*, SymbolTable*, int, int);
+int classStatement(IOTunnel*, SymbolTable*);
+int classCondition(IOTunnel*, SymbolTable*);
+int classExpression(IOTunnel*, SymbolTable*, ExpressionNode**);
+int classTerm(IOTunnel*, SymbolTable*, ExpressionNode**);
+int classFactor(IOTunnel*, SymbolTable*, ExpressionNode**);
 int subclassConstDeclaration(IOTunnel*, SymbolTable*);
 int subclassVarDeclaration(IOTunnel*, SymbolTable*);
-int subclassIdentifierStatement(IOTunnel*, SymbolTable*, int);
-int subclassBeginStatement(IOTunnel*, SymbolTable*, int);
-int subclassIfStatement(IOTunnel*, SymbolTable*, int);
-int subclassWhileStatement(IOTunnel*, SymbolTable*, int);
-int subclassReadStatement(IOTunnel*, SymbolTable*, int);
-int subclassWriteStatement(IOTunnel*, SymbolTable*, int);
+int subclassIdentifierStatement(IOTunnel*, SymbolTable*);
+int subclassBeginStatement(IOTunnel*, SymbolTable*);
+int subclassIfStatement(IOTunnel*, SymbolTable*);
+int subclassWhileStatement(IOTunnel*, SymbolTable*);
+int subclassReadStatement(IOTunnel*, SymbolTable*);
+int subclassWriteStatement(IOTunnel*, SymbolTable*);
+
+// Register functional prototypes.
+ExpressionNode *createExpressionNode(IOTunnel*, int, int, ExpressionNode*, ExpressionNode*);
+int foldExpression(int, ExpressionNode*, ExpressionNode*, int*);
+int emitExpression(IOTunnel*, SymbolTable*, int);
+int emitExpressionNode(IOTunnel*, ExpressionNode*, int, int);
+
+// Peephole functional prototypes.
+int rewriteStoreLoad(Instruction*);
+int rewriteLoadStore(Instruction*);
+int rewriteStoreStore(Instruction*);
+int rewriteNegateLiteral(Instruction*);
+int rewriteNegateNegate(Instruction*);
+void optimizeTail(IOTunnel*);
+char *getPeepholePatternName(int);
+
+// IR functional prototypes.
+int optimizeInstructions(IOTunnel*, int*);
+int isOptimizable(Instruction*, int);
+ControlFlowGraph *createControlFlowGraph(Arena*, Instruction*, int);
+int getRegisterEffect(Instruction, unsigned int*, unsigned int*);
+int evaluateInstruction(Instruction, int*, int*, int*);
+int foldBranches(ControlFlowGraph*, int*);
+int buildBasicBlocks(ControlFlowGraph*);
+int orderBasicBlocks(ControlFlowGraph*);
+void removeUnreachableBlocks(ControlFlowGraph*, int*);
+int findDominators(ControlFlowGraph*);
+int addDefinition(ControlFlowGraph*, int, int, int);
+int buildSSA(ControlFlowGraph*);
+int renameVariables(ControlFlowGraph*);
+int findRegisterSources(ControlFlowGraph*);
+int removeDeadCode(ControlFlowGraph*, int*);
+int findLoops(ControlFlowGraph*);
+int isInLoop(ControlFlowGraph*, int, int);
+int hoistInvariants(ControlFlowGraph*, int*);
+int lowerInstructions(ControlFlowGraph*, int*);
 
 // Printer functional prototypes.
 void printSymbolTable(SymbolTable*);
-void printSymbolTableColumn(TableNode*);
-
-// Queue functional prototypes.
-InstructionQueue *createInstructionQueue(void);
-QueueNode *createQueueNode(Instruction);
-int isQueueEmpty(InstructionQueue*);
-int getQueueSize(InstructionQueue*);
-int enqueueInstruction(InstructionQueue*, Instruction);
-int insertInstruction(InstructionQueue*, Instruction, QueueNode*);
-void clearInstructionQueue(InstructionQueue*);
-void destroyInstructionQueue(InstructionQueue*);
+void printSymbolTableColumn(SymbolTable*, Symbol*);
+void printPeepholeReport(int*);
+void printIRReport(int*);
 
 #endif
@@ -0,0 +1,1447 @@
+// Part of Plum by Tiger Sachse.
+
+#include <stdlib.h>
+#include <string.h>
+#include "generator.h"
+
+// Optimize the emitted code as a whole. The code is split into basic blocks
+// joined by a control flow graph, variables are put in SSA form, and registers
+// are traced to the instructions that wrote them. Branches on known conditions
+// are folded, unreachable blocks and dead code are removed, and invariant
+// expressions are hoisted out of loops, before the code that is left is
+// lowered back to the ISA and put back in the tunnel. The count of each
+// change is added to statistics.
+int optimizeInstructions(IOTunnel *tunnel, int *statistics) {
+    Instruction *grown;
+    ControlFlowGraph *graph;
+
+    if (tunnel == NULL || tunnel->code == NULL || statistics == NULL) {
+        printError(ERROR_NULL_POINTER);
+
+        return SIGNAL_FAILURE;
+    }
+
+    // Only code that stays in one activation record is understood here.
+    if (!isOptimizable(tunnel->code, tunnel->programCounter)) {
+        return SIGNAL_SUCCESS;
+    }
+
+    graph = createControlFlowGraph(tunnel->arena, tunnel->code, tunnel->programCounter);
+    if (graph == NULL) {
+        return SIGNAL_FAILURE;
+    }
+
+    if (foldBranches(graph, statistics) == SIGNAL_FAILURE ||
+        buildBasicBlocks(graph) == SIGNAL_FAILURE ||
+        orderBasicBlocks(graph) == SIGNAL_FAILURE) {
+
+        return SIGNAL_FAILURE;
+    }
+    removeUnreachableBlocks(graph, statistics);
+
+    if (findDominators(graph) == SIGNAL_FAILURE ||
+        buildSSA(graph) == SIGNAL_FAILURE) {
+
+        return SIGNAL_FAILURE;
+    }
+    if (findRegisterSources(graph) == SIGNAL_FAILURE ||
+        removeDeadCode(graph, statistics) == SIGNAL_FAILURE) {
+
+        return SIGNAL_FAILURE;
+    }
+    if (findLoops(graph) == SIGNAL_FAILURE ||
+        hoistInvariants(graph, statistics) == SIGNAL_FAILURE ||
+        lowerInstructions(graph, statistics) == SIGNAL_FAILURE) {
+
+        return SIGNAL_FAILURE;
+    }
+
+    // Preheaders can leave more code than was emitted, so the code array
+    // grows the same way it does while emitting.
+    while (graph->count > tunnel->codeCapacity) {
+        grown = realloc(tunnel->code, sizeof(Instruction) * tunnel->codeCapacity * 2);
+        if (grown == NULL) {
+            printError(ERROR_OUT_OF_MEMORY);
+
+            return SIGNAL_FAILURE;
+        }
+
+        tunnel->code = grown;
+        tunnel->codeCapacity *= 2;
+    }
+    memcpy(tunnel->code, graph->code, sizeof(Instruction) * graph->count);
+    tunnel->programCounter = graph->count;
+
+    return SIGNAL_SUCCESS;
+}
+
+// Check that the code never calls, returns, or reaches outside the current
+// activation record, which is all the generator emits.
+int isOptimizable(Instruction *code, int count) {
+    int i;
+
+    for (i = 0; i < count; i++) {
+        if (code[i].opCode == CAL || code[i].opCode == RTN) {
+            return 0;
+        }
+        if ((code[i].opCode == LOD || code[i].opCode == STO) &&
+            (code[i].LField != 0 || code[i].MField < 0)) {
+
+            return 0;
+        }
+        if ((code[i].opCode == JMP || code[i].opCode == JPC) &&
+            (code[i].MField < 0 || code[i].MField >= count)) {
+
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+// Create an empty control flow graph in the arena for count instructions.
+ControlFlowGraph *createControlFlowGraph(Arena *arena, Instruction *code, int count) {
+    int i;
+    ControlFlowGraph *graph;
+
+    if ((graph = allocateFromArena(arena, sizeof(ControlFlowGraph))) == NULL) {
+        return NULL;
+    }
+
+    graph->arena = arena;
+    graph->code = code;
+    graph->count = count;
+    graph->removed = allocateFromArena(arena, sizeof(char) * (count + 1));
+    graph->leader = allocateFromArena(arena, sizeof(char) * (count + 1));
+    graph->blockOf = allocateFromArena(arena, sizeof(int) * (count + 1));
+    graph->uses = allocateFromArena(arena, sizeof(int) * (count + 1));
+    if (graph->removed == NULL || graph->leader == NULL ||
+        graph->blockOf == NULL || graph->uses == NULL) {
+
+        return NULL;
+    }
+
+    // Blocks start at the first instruction, at every jump target, and after
+    // every instruction that doesn't fall through.
+    graph->leader[0] = 1;
+    for (i = 0; i < count; i++) {
+        if (code[i].opCode == JMP || code[i].opCode == JPC) {
+            graph->leader[code[i].MField] = 1;
+            graph->leader[i + 1] = 1;
+        }
+        else if (code[i].opCode == SIO && code[i].MField == CALL_KILL) {
+            graph->leader[i + 1] = 1;
+        }
+
+        // Every variable gets a slot, whether it's in the frame or not.
+        if ((code[i].opCode == LOD || code[i].opCode == STO) &&
+            code[i].MField >= graph->variables) {
+
+            graph->variables = code[i].MField + 1;
+        }
+    }
+
+    return graph;
+}
+
+// Find which registers an instruction reads and writes. Returns whether the
+// instruction does nothing else, so that it can be removed if nothing reads
+// what it writes. Divisions aren't, as they can fail at run time.
+int getRegisterEffect(Instruction instruction, unsigned int *reads, unsigned int *writes) {
+    *reads = 0;
+    *writes = 0;
+
+    switch (instruction.opCode) {
+        case LIT:
+        case LOD:
+            *writes = 1u << instruction.RField;
+
+            return 1;
+
+        case STO:
+        case JPC:
+            *reads = 1u << instruction.RField;
+
+            return 0;
+
+        case NEG:
+            *reads = 1u << instruction.LField;
+            *writes = 1u << instruction.RField;
+
+            return 1;
+
+        case ODD:
+            *reads = 1u << instruction.RField;
+            *writes = 1u << instruction.RField;
+
+            return 1;
+
+        case ADD: case SUB: case MUL:
+        case EQL: case NEQ: case LSS:
+        case LEQ: case GTR: case GEQ:
+            *reads = (1u << instruction.LField) | (1u << instruction.MField);
+            *writes = 1u << instruction.RField;
+
+            return 1;
+
+        case DIV:
+        case MOD:
+            *reads = (1u << instruction.LField) | (1u << instruction.MField);
+            *writes = 1u << instruction.RField;
+
+            return 0;
+
+        case SIO:
+            if (instruction.MField == CALL_PRINT) {
+                *reads = 1u << instruction.RField;
+            }
+            else if (instruction.MField == CALL_SCAN) {
+                *writes = 1u << instruction.RField;
+            }
+
+            return 0;
+
+        default:
+            return 0;
+    }
+}
+
+// Work out the value an instruction leaves in its R register, if its operands
+// are known. Returns SIGNAL_FAILURE if the value can't be known at compile
+// time. Arithmetic wraps around like the machine's registers do.
+int evaluateInstruction(Instruction instruction, int *known, int *values, int *value) {
+    unsigned int a;
+    unsigned int b;
+    int l;
+    int m;
+
+    if (instruction.opCode == LIT) {
+        *value = instruction.MField;
+
+        return SIGNAL_SUCCESS;
+    }
+
+    if (instruction.opCode == ODD) {
+        if (!known[instruction.RField]) {
+            return SIGNAL_FAILURE;
+        }
+        *value = (values[instruction.RField] % 2) != 0;
+
+        return SIGNAL_SUCCESS;
+    }
+
+    if (instruction.opCode == NEG) {
+        if (!known[instruction.LField]) {
+            return SIGNAL_FAILURE;
+        }
+        *value = (int) (0u - (unsigned int) values[instruction.LField]);
+
+        return SIGNAL_SUCCESS;
+    }
+
+    if (instruction.opCode < ADD || instruction.opCode > GEQ ||
+        instruction.opCode == DIV || instruction.opCode == MOD ||
+        !known[instruction.LField] || !known[instruction.MField]) {
+
+        return SIGNAL_FAILURE;
+    }
+
+    l = values[instruction.LField];
+    m = values[instruction.MField];
+    a = (unsigned int) l;
+    b = (unsigned int) m;
+    switch (instruction.opCode) {
+        case ADD: *value = (int) (a + b); break;
+        case SUB: *value = (int) (a - b); break;
+        case MUL: *value = (int) (a * b); break;
+        case EQL: *value = l == m; break;
+        case NEQ: *value = l != m; break;
+        case LSS: *value = l < m; break;
+        case LEQ: *value = l <= m; break;
+        case GTR: *value = l > m; break;
+        case GEQ: *value = l >= m; break;
+    }
+
+    return SIGNAL_SUCCESS;
+}
+
+// Fold every JPC whose condition is known at compile time. A JPC that always
+// jumps becomes a JMP, and one that never jumps is removed. Registers are only
+// tracked from the start of each block, as they never carry values between
+// blocks.
+int foldBranches(ControlFlowGraph *graph, int *statistics) {
+    int i;
+    int value;
+    unsigned int reads;
+    unsigned int writes;
+    int known[REGISTER_COUNT];
+    int values[REGISTER_COUNT];
+    Instruction *instruction;
+
+    memset(known, 0, sizeof(known));
+    memset(values, 0, sizeof(values));
+    for (i = 0; i < graph->count; i++) {
+        instruction = &graph->code[i];
+        if (graph->leader[i]) {
+            memset(known, 0, sizeof(known));
+        }
+
+        if (instruction->opCode == JPC && known[instruction->RField]) {
+            if (values[instruction->RField] == 0) {
+                instruction->opCode = JMP;
+                instruction->RField = 0;
+            }
+            else {
+                graph->removed[i] = 1;
+            }
+            statistics[IR_FOLDED_BRANCHES]++;
+
+            continue;
+        }
+
+        getRegisterEffect(*instruction, &reads, &writes);
+        if (writes != 0) {
+            if (evaluateInstruction(*instruction, known, values, &value) == SIGNAL_SUCCESS) {
+                known[instruction->RField] = 1;
+                values[instruction->RField] = value;
+            }
+            else {
+                known[instruction->RField] = 0;
+            }
+        }
+    }
+
+    return SIGNAL_SUCCESS;
+}
+
+// Split the code into basic blocks at its leaders, and link each block to the
+// blocks control can pass to next.
+int buildBasicBlocks(ControlFlowGraph *graph) {
+    int i;
+    int j;
+    int last;
+    int target;
+    BasicBlock *block;
+
+    for (i = 0; i < graph->count; i++) {
+        graph->blockCount += graph->leader[i];
+    }
+
+    graph->blocks = allocateFromArena(graph->arena, sizeof(BasicBlock) * graph->blockCount);
+    if (graph->blocks == NULL) {
+        return SIGNAL_FAILURE;
+    }
+
+    // Lay out the blocks.
+    for (i = 0, j = -1; i < graph->count; i++) {
+        if (graph->leader[i]) {
+            j++;
+            graph->blocks[j].start = i;
+            graph->blocks[j].order = NO_BLOCK;
+            graph->blocks[j].dominator = NO_BLOCK;
+            graph->blocks[j].firstPhi = NO_DEFINITION;
+            graph->blocks[j].loop = NO_BLOCK;
+            graph->blocks[j].parentLoop = NO_BLOCK;
+        }
+        graph->blocks[j].end = i + 1;
+        graph->blockOf[i] = j;
+    }
+
+    // Find each block's successors from its last instruction.
+    for (i = 0; i < graph->blockCount; i++) {
+        block = &graph->blocks[i];
+        for (last = block->end - 1; last >= block->start && graph->removed[last]; last--);
+
+        if (last >= block->start && graph->code[last].opCode == JMP) {
+            block->successors[block->successorCount++] = graph->blockOf[graph->code[last].MField];
+        }
+        else if (last >= block->start && graph->code[last].opCode == SIO &&
+                 graph->code[last].MField == CALL_KILL) {
+
+            continue;
+        }
+        else {
+            if (block->end < graph->count) {
+                block->successors[block->successorCount++] = i + 1;
+            }
+            if (last >= block->start && graph->code[last].opCode == JPC) {
+                target = graph->blockOf[graph->code[last].MField];
+                if (block->successorCount == 0 || block->successors[0] != target) {
+                    block->successors[block->successorCount++] = target;
+                }
+            }
+        }
+
+        for (j = 0; j < block->successorCount; j++) {
+            graph->blocks[block->successors[j]].predecessorCount++;
+        }
+    }
+
+    // Fill in the predecessors now that their counts are known.
+    for (i = 0; i < graph->blockCount; i++) {
+        block = &graph->blocks[i];
+        block->predecessors = allocateFromArena(graph->arena, sizeof(int) * (block->predecessorCount + 1));
+        if (block->predecessors == NULL) {
+            return SIGNAL_FAILURE;
+        }
+        block->predecessorCount = 0;
+    }
+    for (i = 0; i < graph->blockCount; i++) {
+        block = &graph->blocks[i];
+        for (j = 0; j < block->successorCount; j++) {
+            target = block->successors[j];
+            graph->blocks[target].predecessors[graph->blocks[target].predecessorCount++] = i;
+        }
+    }
+
+    return SIGNAL_SUCCESS;
+}
+
+// Number the blocks reachable from the first one in reverse postorder, with a
+// depth first search that keeps its own stack. Unreachable blocks keep the
+// order NO_BLOCK.
+int orderBasicBlocks(ControlFlowGraph *graph) {
+    int top;
+    int next;
+    int block;
+    int visited;
+    int *stack;
+    int *edges;
+
+    stack = allocateFromArena(graph->arena, sizeof(int) * graph->blockCount);
+    edges = allocateFromArena(graph->arena, sizeof(int) * graph->blockCount);
+    graph->order = allocateFromArena(graph->arena, sizeof(int) * graph->blockCount);
+    if (stack == NULL || edges == NULL || graph->order == NULL) {
+        return SIGNAL_FAILURE;
+    }
+
+    // Blocks are marked as visited by giving them any order, and renumbered
+    // once they are finished.
+    top = 0;
+    visited = 0;
+    stack[top++] = 0;
+    graph->blocks[0].order = 0;
+    while (top > 0) {
+        block = stack[top - 1];
+        if (edges[block] < graph->blocks[block].successorCount) {
+            next = graph->blocks[block].successors[edges[block]++];
+            if (graph->blocks[next].order == NO_BLOCK) {
+                graph->blocks[next].order = 0;
+                stack[top++] = next;
+            }
+        }
+        else {
+            graph->order[visited++] = block;
+            top--;
+        }
+    }
+
+    // Reverse the postorder.
+    graph->reachable = visited;
+    for (top = 0; top < visited / 2; top++) {
+        block = graph->order[top];
+        graph->order[top] = graph->order[visited - 1 - top];
+        graph->order[visited - 1 - top] = block;
+    }
+    for (top = 0; top < visited; top++) {
+        graph->blocks[graph->order[top]].order = top;
+    }
+
+    return SIGNAL_SUCCESS;
+}
+
+// Remove every block that control can never reach.
+void removeUnreachableBlocks(ControlFlowGraph *graph, int *statistics) {
+    int i;
+    int j;
+    int removed;
+
+    for (i = 0; i < graph->blockCount; i++) {
+        if (graph->blocks[i].order != NO_BLOCK) {
+            continue;
+        }
+
+        removed = 0;
+        for (j = graph->blocks[i].start; j < graph->blocks[i].end; j++) {
+            if (!graph->removed[j]) {
+                graph->removed[j] = 1;
+                removed = 1;
+            }
+        }
+        statistics[IR_UNREACHABLE_BLOCKS] += removed;
+    }
+}
+
+// Find the immediate dominator of every reachable block, using the iterative
+// algorithm of Cooper, Harvey, and Kennedy, then build the dominator tree.
+int findDominators(ControlFlowGraph *graph) {
+    int i;
+    int j;
+    int a;
+    int b;
+    int changed;
+    int dominator;
+    int predecessor;
+    BasicBlock *block;
+    BasicBlock *parent;
+
+    graph->blocks[0].dominator = 0;
+    do {
+        changed = 0;
+        for (i = 1; i < graph->reachable; i++) {
+            block = &graph->blocks[graph->order[i]];
+
+            // Meet the dominators of every predecessor that has one so far.
+            dominator = NO_BLOCK;
+            for (j = 0; j < block->predecessorCount; j++) {
+                predecessor = block->predecessors[j];
+                if (graph->blocks[predecessor].dominator == NO_BLOCK) {
+                    continue;
+                }
+                if (dominator == NO_BLOCK) {
+                    dominator = predecessor;
+
+                    continue;
+                }
+
+                a = predecessor;
+                b = dominator;
+                while (a != b) {
+                    while (graph->blocks[a].order > graph->blocks[b].order) {
+                        a = graph->blocks[a].dominator;
+                    }
+                    while (graph->blocks[b].order > graph->blocks[a].order) {
+                        b = graph->blocks[b].dominator;
+                    }
+                }
+                dominator = a;
+            }
+
+            if (block->dominator != dominator) {
+                block->dominator = dominator;
+                changed = 1;
+            }
+        }
+    } while (changed);
+
+    // Hang every block under its immediate dominator.
+    for (i = 1; i < graph->reachable; i++) {
+        graph->blocks[graph->blocks[graph->order[i]].dominator].childCount++;
+    }
+    for (i = 0; i < graph->reachable; i++) {
+        block = &graph->blocks[graph->order[i]];
+        block->children = allocateFromArena(graph->arena, sizeof(int) * (block->childCount + 1));
+        if (block->children == NULL) {
+            return SIGNAL_FAILURE;
+        }
+        block->childCount = 0;
+    }
+    for (i = 1; i < graph->reachable; i++) {
+        parent = &graph->blocks[graph->blocks[graph->order[i]].dominator];
+        parent->children[parent->childCount++] = graph->order[i];
+    }
+
+    return SIGNAL_SUCCESS;
+}
+
+// Add a definition to the graph, growing its array in the arena when full.
+int addDefinition(ControlFlowGraph *graph, int variable, int block, int instruction) {
+    Definition *definitions;
+
+    if (graph->definitionCount == graph->definitionCapacity) {
+        graph->definitionCapacity = (graph->definitionCapacity == 0) ?
+                                    INITIAL_DEFINITION_CAPACITY :
+                                    graph->definitionCapacity * 2;
+        definitions = allocateFromArena(graph->arena, sizeof(Definition) * graph->definitionCapacity);
+        if (definitions == NULL) {
+            return NO_DEFINITION;
+        }
+        if (graph->definitionCount > 0) {
+            memcpy(definitions, graph->definitions, sizeof(Definition) * graph->definitionCount);
+        }
+        graph->definitions = definitions;
+    }
+
+    graph->definitions[graph->definitionCount].variable = variable;
+    graph->definitions[graph->definitionCount].block = block;
+    graph->definitions[graph->definitionCount].instruction = instruction;
+    graph->definitions[graph->definitionCount].live = 0;
+    graph->definitions[graph->definitionCount].previous = NO_DEFINITION;
+    graph->definitions[graph->definitionCount].operands = NULL;
+    graph->definitions[graph->definitionCount].nextPhi = NO_DEFINITION;
+
+    return graph->definitionCount++;
+}
+
+// Put the variables in SSA form, after Cytron et al. A phi is placed in every
+// block on the iterated dominance frontier of a variable's stores, for
+// variables that are loaded in some block before being stored there. Then the
+// dominator tree is walked to give every load the one definition it reads.
+int buildSSA(ControlFlowGraph *graph) {
+    int i;
+    int j;
+    int top;
+    int block;
+    int phi;
+    int runner;
+    int variable;
+    int *placed;
+    int *queued;
+    int *worklist;
+    int *stored;
+    int *global;
+    ListNode **frontiers;
+    ListNode **stores;
+    ListNode *node;
+    BasicBlock *current;
+
+    placed = allocateFromArena(graph->arena, sizeof(int) * graph->blockCount);
+    queued = allocateFromArena(graph->arena, sizeof(int) * graph->blockCount);
+    worklist = allocateFromArena(graph->arena, sizeof(int) * graph->blockCount);
+    frontiers = allocateFromArena(graph->arena, sizeof(ListNode*) * graph->blockCount);
+    stored = allocateFromArena(graph->arena, sizeof(int) * (graph->variables + 1));
+    global = allocateFromArena(graph->arena, sizeof(int) * (graph->variables + 1));
+    stores = allocateFromArena(graph->arena, sizeof(ListNode*) * (graph->variables + 1));
+    if (placed == NULL || queued == NULL || worklist == NULL || frontiers == NULL ||
+        stored == NULL || global == NULL || stores == NULL) {
+
+        return SIGNAL_FAILURE;
+    }
+
+    // Find the dominance frontiers. A block is in the frontier of every block
+    // between each of its predecessors and its immediate dominator.
+    for (i = 0; i < graph->reachable; i++) {
+        current = &graph->blocks[graph->order[i]];
+        if (current->predecessorCount < 2) {
+            continue;
+        }
+        for (j = 0; j < current->predecessorCount; j++) {
+            runner = current->predecessors[j];
+            if (graph->blocks[runner].order == NO_BLOCK) {
+                continue;
+            }
+            while (runner != current->dominator) {
+                if (frontiers[runner] == NULL || frontiers[runner]->value != graph->order[i]) {
+                    if ((node = allocateFromArena(graph->arena, sizeof(ListNode))) == NULL) {
+                        return SIGNAL_FAILURE;
+                    }
+                    node->value = graph->order[i];
+                    node->next = frontiers[runner];
+                    frontiers[runner] = node;
+                }
+                runner = graph->blocks[runner].dominator;
+            }
+        }
+    }
+
+    // Find the blocks that store each variable, and the variables that are
+    // read before they are written in some block.
+    for (i = 0; i <= graph->variables; i++) {
+        stored[i] = NO_BLOCK;
+    }
+    for (i = 0; i < graph->reachable; i++) {
+        block = graph->order[i];
+        current = &graph->blocks[block];
+        for (j = current->start; j < current->end; j++) {
+            if (graph->removed[j]) {
+                continue;
+            }
+
+            variable = graph->code[j].MField;
+            if (graph->code[j].opCode == LOD && stored[variable] != block) {
+                global[variable] = 1;
+            }
+            else if (graph->code[j].opCode == STO && stored[variable] != block) {
+                stored[variable] = block;
+                if ((node = allocateFromArena(graph->arena, sizeof(ListNode))) == NULL) {
+                    return SIGNAL_FAILURE;
+                }
+                node->value = block;
+                node->next = stores[variable];
+                stores[variable] = node;
+            }
+        }
+    }
+
+    // Place the phis, one variable at a time.
+    for (i = 0; i < graph->blockCount; i++) {
+        placed[i] = -1;
+        queued[i] = -1;
+    }
+    for (variable = 0; variable < graph->variables; variable++) {
+        if (!global[variable]) {
+            continue;
+        }
+
+        top = 0;
+        for (node = stores[variable]; node != NULL; node = node->next) {
+            queued[node->value] = variable;
+            worklist[top++] = node->value;
+        }
+
+        while (top > 0) {
+            block = worklist[--top];
+            for (node = frontiers[block]; node != NULL; node = node->next) {
+                if (placed[node->value] == variable) {
+                    continue;
+                }
+                placed[node->value] = variable;
+
+                current = &graph->blocks[node->value];
+                if ((phi = addDefinition(graph, variable, node->value, NO_INSTRUCTION)) == NO_DEFINITION) {
+                    return SIGNAL_FAILURE;
+                }
+                graph->definitions[phi].operandCount = current->predecessorCount;
+                graph->definitions[phi].operands = allocateFromArena(graph->arena,
+                                                                     sizeof(int) * (current->predecessorCount + 1));
+                if (graph->definitions[phi].operands == NULL) {
+                    return SIGNAL_FAILURE;
+                }
+                for (j = 0; j < current->predecessorCount; j++) {
+                    graph->definitions[phi].operands[j] = NO_DEFINITION;
+                }
+                graph->definitions[phi].nextPhi = current->firstPhi;
+                current->firstPhi = phi;
+
+                if (queued[node->value] != variable) {
+                    queued[node->value] = variable;
+                    worklist[top++] = node->value;
+                }
+            }
+        }
+    }
+
+    return renameVariables(graph);
+}
+
+// Walk the dominator tree, keeping the current definition of every variable,
+// to connect each load to the definition it reads and fill in the operands of
+// the phis. The walk keeps its own stack, where a block appears once on the
+// way down and once more, negated, on the way back up.
+int renameVariables(ControlFlowGraph *graph) {
+    int i;
+    int j;
+    int k;
+    int top;
+    int block;
+    int phi;
+    int definition;
+    int variable;
+    int *stack;
+    int *current;
+    int *firstStore;
+    int *lastStore;
+    BasicBlock *node;
+    BasicBlock *successor;
+
+    stack = allocateFromArena(graph->arena, sizeof(int) * (graph->reachable * 2 + 1));
+    current = allocateFromArena(graph->arena, sizeof(int) * (graph->variables + 1));
+    firstStore = allocateFromArena(graph->arena, sizeof(int) * graph->blockCount);
+    lastStore = allocateFromArena(graph->arena, sizeof(int) * graph->blockCount);
+    if (stack == NULL || current == NULL || firstStore == NULL || lastStore == NULL) {
+        return SIGNAL_FAILURE;
+    }
+
+    // Variables start out with the value they have on entry.
+    for (i = 0; i <= graph->variables; i++) {
+        current[i] = NO_DEFINITION;
+    }
+
+    top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        block = stack[--top];
+
+        // On the way back up, restore the definitions from before the block.
+        if (block < 0) {
+            block = -block - 1;
+            node = &graph->blocks[block];
+            for (i = lastStore[block] - 1; i >= firstStore[block]; i--) {
+                current[graph->definitions[i].variable] = graph->definitions[i].previous;
+            }
+            for (phi = node->firstPhi; phi != NO_DEFINITION; phi = graph->definitions[phi].nextPhi) {
+                current[graph->definitions[phi].variable] = graph->definitions[phi].previous;
+            }
+
+            continue;
+        }
+
+        node = &graph->blocks[block];
+        for (phi = node->firstPhi; phi != NO_DEFINITION; phi = graph->definitions[phi].nextPhi) {
+            variable = graph->definitions[phi].variable;
+            graph->definitions[phi].previous = current[variable];
+            current[variable] = phi;
+        }
+
+        // Loads read the current definition, and stores replace it.
+        firstStore[block] = graph->definitionCount;
+        for (i = node->start; i < node->end; i++) {
+            if (graph->removed[i]) {
+                continue;
+            }
+
+            variable = graph->code[i].MField;
+            if (graph->code[i].opCode == LOD) {
+                graph->uses[i] = current[variable];
+            }
+            else if (graph->code[i].opCode == STO) {
+                if ((definition = addDefinition(graph, variable, block, i)) == NO_DEFINITION) {
+                    return SIGNAL_FAILURE;
+                }
+                graph->definitions[definition].previous = current[variable];
+                current[variable] = definition;
+                graph->uses[i] = definition;
+            }
+        }
+        lastStore[block] = graph->definitionCount;
+
+        // Hand the current definitions to the phis of the successors.
+        for (i = 0; i < node->successorCount; i++) {
+            successor = &graph->blocks[node->successors[i]];
+            for (j = 0; j < successor->predecessorCount && successor->predecessors[j] != block; j++);
+            for (phi = successor->firstPhi; phi != NO_DEFINITION; phi = graph->definitions[phi].nextPhi) {
+                graph->definitions[phi].operands[j] = current[graph->definitions[phi].variable];
+            }
+        }
+
+        stack[top++] = -block - 1;
+        for (k = node->childCount - 1; k >= 0; k--) {
+            stack[top++] = node->children[k];
+        }
+    }
+
+    return SIGNAL_SUCCESS;
+}
+
+// Connect every register an instruction reads to the instruction in the same
+// block that last wrote it. The generator never carries a register from one
+// block into another, but if it happens, the read's source is left as
+// NO_INSTRUCTION, and the register's value could come from any instruction
+// that leaves it set at the end of a block, which are listed in exits.
+int findRegisterSources(ControlFlowGraph *graph) {
+    int i;
+    int j;
+    int k;
+    int r;
+    int last[REGISTER_COUNT];
+    unsigned int reads;
+    unsigned int writes;
+    ListNode *node;
+    BasicBlock *block;
+
+    graph->sources = allocateFromArena(graph->arena, sizeof(int) * (graph->count * 2 + 1));
+    if (graph->sources == NULL) {
+        return SIGNAL_FAILURE;
+    }
+
+    for (i = 0; i < graph->reachable; i++) {
+        block = &graph->blocks[graph->order[i]];
+        for (r = 0; r < REGISTER_COUNT; r++) {
+            last[r] = NO_INSTRUCTION;
+        }
+
+        for (j = block->start; j < block->end; j++) {
+            if (graph->removed[j]) {
+                continue;
+            }
+
+            getRegisterEffect(graph->code[j], &reads, &writes);
+            for (r = 0, k = 0; r < REGISTER_COUNT; r++) {
+                if (reads & (1u << r)) {
+                    graph->sources[j * 2 + k++] = last[r];
+                }
+            }
+            for (r = 0; r < REGISTER_COUNT; r++) {
+                if (writes & (1u << r)) {
+                    last[r] = j;
+                }
+            }
+        }
+
+        for (r = 0; r < REGISTER_COUNT; r++) {
+            if (last[r] != NO_INSTRUCTION) {
+                if ((node = allocateFromArena(graph->arena, sizeof(ListNode))) == NULL) {
+                    return SIGNAL_FAILURE;
+                }
+                node->value = last[r];
+                node->next = graph->exits[r];
+                graph->exits[r] = node;
+            }
+        }
+    }
+
+    return SIGNAL_SUCCESS;
+}
+
+// Remove every instruction whose work is never used, in one sweep. Anything
+// that does more than write a register or store a variable is live from the
+// start, except forward jumps, which are only live if something they jump
+// over is. Then whatever a live instruction reads is live too: the
+// instructions that wrote its registers, and for a load, the definition it
+// reads, which is either a store or a phi whose operands become live in turn.
+// Stores left unmarked are dead stores.
+int removeDeadCode(ControlFlowGraph *graph, int *statistics) {
+    int i;
+    int j;
+    int k;
+    int r;
+    int top;
+    int definitionTop;
+    int source;
+    int definition;
+    char *live;
+    int *worklist;
+    int *enclosing;
+    int *definitions;
+    unsigned int reads;
+    unsigned int writes;
+    ListNode *node;
+    Definition *current;
+    BasicBlock *block;
+
+    live = allocateFromArena(graph->arena, sizeof(char) * (graph->count + 1));
+    worklist = allocateFromArena(graph->arena, sizeof(int) * (graph->count + 1));
+    enclosing = allocateFromArena(graph->arena, sizeof(int) * (graph->count + 1));
+    definitions = allocateFromArena(graph->arena, sizeof(int) * (graph->definitionCount + 1));
+    if (live == NULL || worklist == NULL || enclosing == NULL || definitions == NULL) {
+        return SIGNAL_FAILURE;
+    }
+
+    // Find the innermost forward jump over each instruction, with the open
+    // jumps kept on the worklist. Jumps that overlap without nesting, and
+    // backward jumps, are live from the start.
+    top = 0;
+    for (i = 0; i < graph->count; i++) {
+        while (top > 0 && graph->code[worklist[top - 1]].MField <= i) {
+            top--;
+        }
+        enclosing[i] = (top > 0) ? worklist[top - 1] : NO_INSTRUCTION;
+
+        if (graph->removed[i] ||
+            (graph->code[i].opCode != JMP && graph->code[i].opCode != JPC)) {
+
+            continue;
+        }
+        if (graph->code[i].MField > i &&
+            (top == 0 || graph->code[i].MField <= graph->code[worklist[top - 1]].MField)) {
+
+            worklist[top++] = i;
+        }
+        else {
+            live[i] = 1;
+        }
+    }
+
+    top = 0;
+    for (i = 0; i < graph->reachable; i++) {
+        block = &graph->blocks[graph->order[i]];
+        for (j = block->start; j < block->end; j++) {
+            if (graph->removed[j]) {
+                continue;
+            }
+            if (live[j] ||
+                (graph->code[j].opCode != STO && graph->code[j].opCode != JMP &&
+                 graph->code[j].opCode != JPC &&
+                 !getRegisterEffect(graph->code[j], &reads, &writes))) {
+
+                live[j] = 1;
+                worklist[top++] = j;
+            }
+        }
+    }
+
+    // Every instruction is pushed at most once, when it is marked.
+    while (top > 0) {
+        i = worklist[--top];
+
+        if (enclosing[i] != NO_INSTRUCTION && !live[enclosing[i]]) {
+            live[enclosing[i]] = 1;
+            worklist[top++] = enclosing[i];
+        }
+
+        getRegisterEffect(graph->code[i], &reads, &writes);
+        for (r = 0, k = 0; r < REGISTER_COUNT; r++) {
+            if ((reads & (1u << r)) == 0) {
+                continue;
+            }
+
+            source = graph->sources[i * 2 + k++];
+            if (source != NO_INSTRUCTION) {
+                if (!live[source]) {
+                    live[source] = 1;
+                    worklist[top++] = source;
+                }
+
+                continue;
+            }
+            for (node = graph->exits[r]; node != NULL; node = node->next) {
+                if (!live[node->value]) {
+                    live[node->value] = 1;
+                    worklist[top++] = node->value;
+                }
+            }
+        }
+
+        if (graph->code[i].opCode != LOD) {
+            continue;
+        }
+
+        // Follow the load to the stores it could read.
+        definitionTop = 0;
+        definition = graph->uses[i];
+        if (definition != NO_DEFINITION && !graph->definitions[definition].live) {
+            graph->definitions[definition].live = 1;
+            definitions[definitionTop++] = definition;
+        }
+        while (definitionTop > 0) {
+            current = &graph->definitions[definitions[--definitionTop]];
+            if (current->instruction != NO_INSTRUCTION) {
+                if (!live[current->instruction]) {
+                    live[current->instruction] = 1;
+                    worklist[top++] = current->instruction;
+                }
+
+                continue;
+            }
+            for (j = 0; j < current->operandCount; j++) {
+                definition = current->operands[j];
+                if (definition != NO_DEFINITION && !graph->definitions[definition].live) {
+                    graph->definitions[definition].live = 1;
+                    definitions[definitionTop++] = definition;
+                }
+            }
+        }
+    }
+
+    for (i = 0; i < graph->reachable; i++) {
+        block = &graph->blocks[graph->order[i]];
+        for (j = block->start; j < block->end; j++) {
+            if (graph->removed[j] || live[j]) {
+                continue;
+            }
+
+            graph->removed[j] = 1;
+            if (graph->code[j].opCode == STO) {
+                statistics[IR_DEAD_STORES]++;
+            }
+            else {
+                statistics[IR_DEAD_INSTRUCTIONS]++;
+            }
+        }
+    }
+
+    return SIGNAL_SUCCESS;
+}
+
+// Find the natural loops of the graph and how they nest. Headers are visited
+// from the last in reverse postorder to the first, so that inner loops are
+// found before the loops around them. A loop's body is found by walking back
+// from the blocks that jump back to its header, and an inner loop met on the
+// way is taken in whole through its header. If a loop can be entered other
+// than through its header, no loops are kept, as nothing can be safely
+// hoisted out of it.
+int findLoops(ControlFlowGraph *graph) {
+    int i;
+    int j;
+    int top;
+    int block;
+    int header;
+    int irreducible;
+    int predecessor;
+    int *visited;
+    int *worklist;
+    BasicBlock *current;
+
+    visited = allocateFromArena(graph->arena, sizeof(int) * (graph->blockCount + 1));
+    worklist = allocateFromArena(graph->arena, sizeof(int) * (graph->blockCount * 2 + 1));
+    if (visited == NULL || worklist == NULL) {
+        return SIGNAL_FAILURE;
+    }
+    for (i = 0; i < graph->blockCount; i++) {
+        visited[i] = NO_BLOCK;
+    }
+
+    irreducible = 0;
+    for (i = graph->reachable - 1; i >= 0 && !irreducible; i--) {
+        header = graph->order[i];
+        current = &graph->blocks[header];
+
+        // Edges back to the header must come from blocks it dominates.
+        top = 0;
+        for (j = 0; j < current->predecessorCount; j++) {
+            predecessor = current->predecessors[j];
+            if (graph->blocks[predecessor].order == NO_BLOCK ||
+                graph->blocks[predecessor].order < i) {
+
+                continue;
+            }
+
+            for (block = predecessor;
+                 graph->blocks[block].order > i;
+                 block = graph->blocks[block].dominator);
+            if (block != header) {
+                irreducible = 1;
+
+                break;
+            }
+            worklist[top++] = predecessor;
+        }
+        if (top == 0 || irreducible) {
+            continue;
+        }
+
+        current->loop = header;
+        visited[header] = header;
+        while (top > 0) {
+            // Stand in for a block with the outermost loop found around it.
+            block = worklist[--top];
+            if (graph->blocks[block].loop != NO_BLOCK) {
+                for (block = graph->blocks[block].loop;
+                     graph->blocks[block].parentLoop != NO_BLOCK;
+                     block = graph->blocks[block].parentLoop);
+            }
+            if (visited[block] == header) {
+                continue;
+            }
+            visited[block] = header;
+
+            if (graph->blocks[block].loop == NO_BLOCK) {
+                graph->blocks[block].loop = header;
+            }
+            else {
+                graph->blocks[block].parentLoop = header;
+            }
+
+            for (j = 0; j < graph->blocks[block].predecessorCount; j++) {
+                predecessor = graph->blocks[block].predecessors[j];
+                if (graph->blocks[predecessor].order != NO_BLOCK) {
+                    worklist[top++] = predecessor;
+                }
+            }
+        }
+    }
+
+    for (i = 0; i < graph->blockCount; i++) {
+        if (irreducible) {
+            graph->blocks[i].loop = NO_BLOCK;
+            graph->blocks[i].parentLoop = NO_BLOCK;
+        }
+    }
+
+    // Outer headers come first in reverse postorder.
+    for (i = 0; i < graph->reachable; i++) {
+        current = &graph->blocks[graph->order[i]];
+        if (current->loop == graph->order[i]) {
+            current->loopDepth = (current->parentLoop == NO_BLOCK) ?
+                                 1 :
+                                 graph->blocks[current->parentLoop].loopDepth + 1;
+        }
+    }
+
+    return SIGNAL_SUCCESS;
+}
+
+// Check whether a block is in the loop with the given header.
+int isInLoop(ControlFlowGraph *graph, int block, int header) {
+    int loop;
+
+    for (loop = graph->blocks[block].loop;
+         loop != NO_BLOCK && graph->blocks[loop].loopDepth > graph->blocks[header].loopDepth;
+         loop = graph->blocks[loop].parentLoop);
+
+    return loop == header;
+}
+
+// Hoist the expressions in loops whose inputs never change while the loop runs
+// into a preheader, which runs once each time the loop is entered. Within its
+// innermost loop, an instruction is invariant if it is a literal, a load of a
+// definition made outside the loop, or a pure operation on invariant
+// registers. Every largest invariant expression that does more than load a
+// value is moved in front of the outermost loop it is invariant in, where its
+// value is stored in a new temporary in the frame for the loop to load.
+// Expressions that share a register with other code are left alone.
+int hoistInvariants(ControlFlowGraph *graph, int *statistics) {
+    int i;
+    int j;
+    int k;
+    int r;
+    int loop;
+    int frame;
+    int found;
+    int source;
+    int variant;
+    int definition;
+    int memberCount;
+    char *invariant;
+    char *feedsInvariant;
+    int *users;
+    int *members;
+    unsigned int reads;
+    unsigned int writes;
+    Instruction member;
+    BasicBlock *block;
+    HoistedExpression *hoisted;
+
+    // Temporaries are added to the frame allocated by the program's INC.
+    frame = NO_INSTRUCTION;
+    for (i = 0; i < graph->count && frame == NO_INSTRUCTION; i++) {
+        if (!graph->removed[i] && graph->code[i].opCode == INC) {
+            frame = i;
+        }
+    }
+    if (frame == NO_INSTRUCTION || graph->blockOf[frame] != 0) {
+        return SIGNAL_SUCCESS;
+    }
+
+    invariant = allocateFromArena(graph->arena, sizeof(char) * (graph->count + 1));
+    feedsInvariant = allocateFromArena(graph->arena, sizeof(char) * (graph->count + 1));
+    users = allocateFromArena(graph->arena, sizeof(int) * (graph->count + 1));
+    members = allocateFromArena(graph->arena, sizeof(int) * (graph->count + 2));
+    if (invariant == NULL || feedsInvariant == NULL || users == NULL || members == NULL) {
+        return SIGNAL_FAILURE;
+    }
+
+    // Find what is invariant in each loop, and who uses every register.
+    // Registers carried between blocks aren't understood here, so if there
+    // are any nothing is hoisted.
+    for (i = 0; i < graph->reachable; i++) {
+        block = &graph->blocks[graph->order[i]];
+        for (j = block->start; j < block->end; j++) {
+            if (graph->removed[j]) {
+                continue;
+            }
+
+            invariant[j] = getRegisterEffect(graph->code[j], &reads, &writes) &&
+                           block->loop != NO_BLOCK;
+            if (invariant[j] && graph->code[j].opCode == LOD) {
+                definition = graph->uses[j];
+                invariant[j] = definition == NO_DEFINITION ||
+                               !isInLoop(graph, graph->definitions[definition].block, block->loop);
+            }
+
+            for (r = 0, k = 0; r < REGISTER_COUNT; r++) {
+                if ((reads & (1u << r)) == 0) {
+                    continue;
+                }
+
+                source = graph->sources[j * 2 + k++];
+                if (source == NO_INSTRUCTION) {
+                    return SIGNAL_SUCCESS;
+                }
+                users[source]++;
+                invariant[j] = invariant[j] && invariant[source];
+            }
+        }
+    }
+    for (i = 0; i < graph->count; i++) {
+        if (!graph->removed[i] && invariant[i]) {
+            for (k = 0; k < 2; k++) {
+                if ((source = graph->sources[i * 2 + k]) != NO_INSTRUCTION) {
+                    feedsInvariant[source] = 1;
+                }
+            }
+        }
+    }
+
+    for (i = 0; i < graph->count; i++) {
+        if (graph->removed[i] || !invariant[i] || feedsInvariant[i] ||
+            graph->code[i].opCode == LIT || graph->code[i].opCode == LOD) {
+
+            continue;
+        }
+
+        // Gather the expression, whose registers mustn't be read by anything else.
+        members[0] = i;
+        memberCount = 1;
+        found = 1;
+        for (j = 0; j < memberCount && found; j++) {
+            getRegisterEffect(graph->code[members[j]], &reads, &writes);
+            for (r = 0, k = 0; r < REGISTER_COUNT; r++) {
+                if (reads & (1u << r)) {
+                    source = graph->sources[members[j] * 2 + k++];
+                    members[memberCount++] = source;
+                    found = found && users[source] == 1;
+                }
+            }
+        }
+        if (!found) {
+            continue;
+        }
+
+        // Move out to the outermost loop the expression is invariant in. The
+        // preheader can't come before the frame is allocated.
+        loop = graph->blocks[graph->blockOf[i]].loop;
+        while (graph->blocks[loop].parentLoop != NO_BLOCK &&
+               graph->blocks[graph->blocks[loop].parentLoop].start > frame) {
+
+            variant = 0;
+            for (j = 0; j < memberCount && !variant; j++) {
+                definition = graph->uses[members[j]];
+                variant = graph->code[members[j]].opCode == LOD && definition != NO_DEFINITION &&
+                          isInLoop(graph,
+                                   graph->definitions[definition].block,
+                                   graph->blocks[loop].parentLoop);
+            }
+            if (variant) {
+                break;
+            }
+            loop = graph->blocks[loop].parentLoop;
+        }
+        if (graph->blocks[loop].start <= frame) {
+            continue;
+        }
+
+        // Sources come before the instructions that read them.
+        for (j = 1; j < memberCount; j++) {
+            for (k = j; k > 0 && members[k - 1] > members[k]; k--) {
+                source = members[k];
+                members[k] = members[k - 1];
+                members[k - 1] = source;
+            }
+        }
+
+        hoisted = allocateFromArena(graph->arena, sizeof(HoistedExpression));
+        if (hoisted == NULL ||
+            (hoisted->code = allocateFromArena(graph->arena, sizeof(Instruction) * (memberCount + 1))) == NULL) {
+
+            return SIGNAL_FAILURE;
+        }
+        for (j = 0; j < memberCount; j++) {
+            hoisted->code[j] = graph->code[members[j]];
+            if (members[j] != i) {
+                graph->removed[members[j]] = 1;
+            }
+        }
+
+        member = graph->code[i];
+        setInstruction(&hoisted->code[memberCount], STO, member.RField, 0, graph->code[frame].MField);
+        setInstruction(&graph->code[i], LOD, member.RField, 0, graph->code[frame].MField);
+        graph->code[frame].MField++;
+
+        hoisted->length = memberCount + 1;
+        hoisted->next = graph->blocks[loop].hoisted;
+        graph->blocks[loop].hoisted = hoisted;
+        statistics[IR_HOISTED_INVARIANTS]++;
+    }
+
+    return SIGNAL_SUCCESS;
+}
+
+// Lower the graph back to instructions, with each loop's preheader put just
+// before its header. Control coming into the header from outside the loop runs
+// the preheader, and jumps back to the header from inside the loop skip it.
+// The gaps left by removed instructions are closed, and every jump is pointed
+// at the new place of its target. Jumps that end up targeting the next
+// instruction do nothing, so they are removed too, until none are left. The
+// lowered code replaces the graph's.
+int lowerInstructions(ControlFlowGraph *graph, int *statistics) {
+    int i;
+    int kept;
+    int jumps;
+    int target;
+    int *newIndex;
+    Instruction *lowered;
+    BasicBlock *block;
+    HoistedExpression *hoisted;
+
+    if ((newIndex = allocateFromArena(graph->arena, sizeof(int) * (graph->count + 1))) == NULL) {
+        return SIGNAL_FAILURE;
+    }
+
+    // Control reaching an instruction goes on to the first instruction that
+    // is kept or hoisted at or after it.
+    kept = 0;
+    for (i = 0; i < graph->count; i++) {
+        newIndex[i] = kept;
+        block = &graph->blocks[graph->blockOf[i]];
+        if (block->start == i) {
+            for (hoisted = block->hoisted; hoisted != NULL; hoisted = hoisted->next) {
+                kept += hoisted->length;
+            }
+        }
+        kept += !graph->removed[i];
+    }
+    newIndex[graph->count] = kept;
+
+    if ((lowered = allocateFromArena(graph->arena, sizeof(Instruction) * (kept + 1))) == NULL) {
+        return SIGNAL_FAILURE;
+    }
+
+    kept = 0;
+    for (i = 0; i < graph->count; i++) {
+        block = &graph->blocks[graph->blockOf[i]];
+        if (block->start == i) {
+            for (hoisted = block->hoisted; hoisted != NULL; hoisted = hoisted->next) {
+                memcpy(&lowered[kept], hoisted->code, sizeof(Instruction) * hoisted->length);
+                kept += hoisted->length;
+            }
+        }
+        if (graph->removed[i]) {
+            continue;
+        }
+
+        lowered[kept] = graph->code[i];
+        if (lowered[kept].opCode == JMP || lowered[kept].opCode == JPC) {
+            target = lowered[kept].MField;
+            lowered[kept].MField = newIndex[target];
+
+            block = &graph->blocks[graph->blockOf[target]];
+            if (block->start == target && block->hoisted != NULL &&
+                isInLoop(graph, graph->blockOf[i], graph->blockOf[target])) {
+
+                for (hoisted = block->hoisted; hoisted != NULL; hoisted = hoisted->next) {
+                    lowered[kept].MField += hoisted->length;
+                }
+            }
+        }
+        kept++;
+    }
+
+    graph->code = lowered;
+    graph->count = kept;
+    graph->removed = allocateFromArena(graph->arena, sizeof(char) * (graph->count + 1));
+    newIndex = allocateFromArena(graph->arena, sizeof(int) * (graph->count + 1));
+    if (graph->removed == NULL || newIndex == NULL) {
+        return SIGNAL_FAILURE;
+    }
+
+    do {
+        jumps = 0;
+        for (i = 0; i < graph->count; i++) {
+            if ((graph->code[i].opCode == JMP || graph->code[i].opCode == JPC) &&
+                graph->code[i].MField == i + 1) {
+
+                graph->removed[i] = 1;
+                statistics[IR_REMOVED_JUMPS]++;
+                jumps = 1;
+            }
+        }
+        if (!jumps) {
+            break;
+        }
+
+        // A removed target moves to the next instruction that is kept.
+        kept = 0;
+        for (i = 0; i < graph->count; i++) {
+            newIndex[i] = kept;
+            kept += !graph->removed[i];
+        }
+        newIndex[graph->count] = kept;
+
+        kept = 0;
+        for (i = 0; i < graph->count; i++) {
+            if (graph->removed[i]) {
+                continue;
+            }
+            graph->code[kept] = graph->code[i];
+            if (graph->code[kept].opCode == JMP || graph->code[kept].opCode == JPC) {
+                graph->code[kept].MField = newIndex[graph->code[kept].MField];
+            }
+            kept++;
+        }
+        memset(graph->removed, 0, sizeof(char) * (graph->count + 1));
+        graph->count = kept;
+    } while (jumps);
+
+    return SIGNAL_SUCCESS;
+}
@@ -0,0 +1,115 @@
+// Part of Plum by Tiger Sachse.
+
+#include "generator.h"
+
+// STO r, l, a + LOD r, l, a: the register still holds what was just stored.
+int rewriteStoreLoad(Instruction *window) {
+    if (window[0].opCode == STO && window[1].opCode == LOD &&
+        window[0].RField == window[1].RField &&
+        window[0].LField == window[1].LField &&
+        window[0].MField == window[1].MField) {
+
+        return 1;
+    }
+
+    return NO_REWRITE;
+}
+
+// LOD r, l, a + STO r, l, a: storing a value back where it came from.
+int rewriteLoadStore(Instruction *window) {
+    if (window[0].opCode == LOD && window[1].opCode == STO &&
+        window[0].RField == window[1].RField &&
+        window[0].LField == window[1].LField &&
+        window[0].MField == window[1].MField) {
+
+        return 1;
+    }
+
+    return NO_REWRITE;
+}
+
+// STO r, l, a + STO r, l, a: the same store twice.
+int rewriteStoreStore(Instruction *window) {
+    if (window[0].opCode == STO && window[1].opCode == STO &&
+        window[0].RField == window[1].RField &&
+        window[0].LField == window[1].LField &&
+        window[0].MField == window[1].MField) {
+
+        return 1;
+    }
+
+    return NO_REWRITE;
+}
+
+// LIT r, 0, v + NEG r, r: a negative literal.
+int rewriteNegateLiteral(Instruction *window) {
+    if (window[0].opCode == LIT && window[1].opCode == NEG &&
+        window[1].RField == window[0].RField &&
+        window[1].LField == window[0].RField) {
+
+        window[0].MField = (int) (0u - (unsigned int) window[0].MField);
+
+        return 1;
+    }
+
+    return NO_REWRITE;
+}
+
+// NEG r, r + NEG r, r: the negations cancel out.
+int rewriteNegateNegate(Instruction *window) {
+    if (window[0].opCode == NEG && window[1].opCode == NEG &&
+        window[0].RField == window[0].LField &&
+        window[1].RField == window[0].RField &&
+        window[1].LField == window[0].RField) {
+
+        return 0;
+    }
+
+    return NO_REWRITE;
+}
+
+// Every rewrite pattern, indexed the same as the tunnel's peepholeHits.
+PeepholePattern peepholePatterns[PEEPHOLE_PATTERNS] = {
+    { "STO LOD", 2, rewriteStoreLoad },
+    { "LOD STO", 2, rewriteLoadStore },
+    { "STO STO", 2, rewriteStoreStore },
+    { "LIT NEG", 2, rewriteNegateLiteral },
+    { "NEG NEG", 2, rewriteNegateNegate }
+};
+
+// Run the rewrite patterns over the newest instructions until none of them
+// match. Only instructions at or past the tunnel's barrier are looked at, so
+// nothing that a jump lands on or whose address has been recorded is moved.
+void optimizeTail(IOTunnel *tunnel) {
+    int i;
+    int start;
+    int length;
+    int rewritten;
+
+    do {
+        rewritten = 0;
+        for (i = 0; i < PEEPHOLE_PATTERNS; i++) {
+            start = tunnel->programCounter - peepholePatterns[i].length;
+            if (start < tunnel->barrier) {
+                continue;
+            }
+
+            length = peepholePatterns[i].rewrite(&tunnel->code[start]);
+            if (length != NO_REWRITE) {
+                tunnel->programCounter = start + length;
+                tunnel->peepholeHits[i]++;
+                rewritten = 1;
+                break;
+            }
+        }
+    } while (rewritten);
+}
+
+// Get the name of a rewrite pattern, for the optimization report.
+char *getPeepholePatternName(int pattern) {
+    if (pattern < 0 || pattern >= PEEPHOLE_PATTERNS) {
+        return "";
+    }
+
+    return peepholePatterns[pattern].name;
+}
@@ -5,6 +5,8 @@
 
 // Print the symbol table.
 void printSymbolTable(SymbolTable *table) {
+    int i;
+
     if (table == NULL) {
         printf("No table.\n");
         
@@ -15,25 +17,68 @@ void printSymbolTable(SymbolTable *table) {
     printf("TYPE VALUE LEVEL ACTIVE ADDRESS NAME\n");
     printf("------------------------------------\n");
    
-    // Recursively call print on the head of the table.
-    printSymbolTableColumn(table->head);
+    // Print every symbol in the order it was declared.
+    for (i = 0; i < table->symbols; i++) {
+        printSymbolTableColumn(table, &table->entries[i]);
+    }
     printf("\n");
 }
 
 // Print a column in the symbol table.
-void printSymbolTableColumn(TableNode *node) {
-    if (node == NULL) {
+void printSymbolTableColumn(SymbolTable *table, Symbol *symbol) {
+    printf("%-4d %-5d %-5d %-6d %-7d %s\n",
+           symbol->type,
+           symbol->value,
+           symbol->level,
+           symbol->active,
+           symbol->address,
+           getInternedName(table->names, symbol->name));
+}
+
+// Print how many times each peephole pattern was rewritten.
+void printPeepholeReport(int *hits) {
+    int i;
+    int total;
+
+    if (hits == NULL) {
+        printError(ERROR_NULL_POINTER);
+
         return;
     }
 
-    // Print the next column, then print this one. The table is saved
-    // in reverse order so printing like this will reverse the reversed list.
-    printSymbolTableColumn(node->next);
-    printf("%-4d %-5d %-5d %-6d %-7d %s\n",
-           node->symbol.type,
-           node->symbol.value,
-           node->symbol.level,
-           node->symbol.active,
-           node->symbol.address,
-           node->symbol.name);
+    printf("Peephole Optimizations:\n");
+    printf("PATTERN      COUNT\n");
+    printf("------------------\n");
+
+    total = 0;
+    for (i = 0; i < PEEPHOLE_PATTERNS; i++) {
+        printf("%-12s %d\n", getPeepholePatternName(i), hits[i]);
+        total += hits[i];
+    }
+    printf("%-12s %d\n\n", "TOTAL", total);
+}
+
+// Print how many changes of each kind the IR optimizer made.
+void printIRReport(int *statistics) {
+    int i;
+
+    char *changes[] = {
+        "Folded branches", "Unreachable blocks", "Dead stores",
+        "Dead instructions", "Hoisted invariants", "Removed jumps"
+    };
+
+    if (statistics == NULL) {
+        printError(ERROR_NULL_POINTER);
+
+        return;
+    }
+
+    printf("IR Optimizations:\n");
+    printf("CHANGE             COUNT\n");
+    printf("------------------------\n");
+
+    for (i = 0; i < IR_STATISTICS; i++) {
+        printf("%-18s %d\n", changes[i], statistics[i]);
+    }
+    printf("\n");
 }
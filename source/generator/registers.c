@@ -0,0 +1,199 @@
+// Part of Plum by Tiger Sachse.
+
+#include "generator.h"
+
+// Create an expression node in the tunnel's arena, and label it with the
+// number of registers needed to evaluate it without spilling (its Sethi-Ullman
+// number). Leaves take one register. An operation whose operands need the
+// same number takes one more, since one operand must be held while the other
+// is evaluated; otherwise the larger operand is evaluated first and its
+// register count is enough. Operations on literals are folded into a LIT.
+ExpressionNode *createExpressionNode(IOTunnel *tunnel,
+                                     int opCode,
+                                     int value,
+                                     ExpressionNode *left,
+                                     ExpressionNode *right) {
+    int folded;
+    ExpressionNode *node;
+
+    if (left != NULL && foldExpression(opCode, left, right, &folded) == SIGNAL_SUCCESS) {
+        opCode = LIT;
+        value = folded;
+        left = NULL;
+        right = NULL;
+    }
+
+    if ((node = allocateFromArena(tunnel->arena, sizeof(ExpressionNode))) == NULL) {
+        return NULL;
+    }
+
+    node->opCode = opCode;
+    node->value = value;
+    node->left = left;
+    node->right = right;
+
+    if (left == NULL) {
+        node->registers = 1;
+    }
+    else if (right == NULL) {
+        node->registers = left->registers;
+    }
+    else if (left->registers == right->registers) {
+        node->registers = left->registers + 1;
+    }
+    else {
+        node->registers = (left->registers > right->registers) ?
+                          left->registers :
+                          right->registers;
+    }
+
+    return node;
+}
+
+// Work out the value of an operation on literal operands at compile time,
+// the same way the machine would at run time. Fails if an operand isn't a
+// literal, or if the machine would report an error or overflow while
+// dividing, which is left for run time to keep the program's behaviour.
+int foldExpression(int opCode, ExpressionNode *left, ExpressionNode *right, int *value) {
+    unsigned int a;
+    unsigned int b;
+
+    if (left->opCode != LIT || (right != NULL && right->opCode != LIT)) {
+        return SIGNAL_FAILURE;
+    }
+
+    // Arithmetic wraps around like the machine's registers do.
+    a = (unsigned int) left->value;
+    b = (right == NULL) ? 0 : (unsigned int) right->value;
+    switch (opCode) {
+        case NEG: *value = (int) (0u - a); break;
+        case ADD: *value = (int) (a + b); break;
+        case SUB: *value = (int) (a - b); break;
+        case MUL: *value = (int) (a * b); break;
+        case DIV:
+            if (right->value == 0 ||
+                (left->value == INT_MIN && right->value == -1)) {
+
+                return SIGNAL_FAILURE;
+            }
+            *value = left->value / right->value;
+            break;
+        default: return SIGNAL_FAILURE;
+    }
+
+    return SIGNAL_SUCCESS;
+}
+
+// Parse an expression and emit code that leaves its value in the register at
+// registerPosition.
+int emitExpression(IOTunnel *tunnel, SymbolTable *table, int registerPosition) {
+    ExpressionNode *expression;
+
+    if (classExpression(tunnel, table, &expression) == SIGNAL_FAILURE) {
+        return SIGNAL_FAILURE;
+    }
+
+    return emitExpressionNode(tunnel, expression, registerPosition, tunnel->spillBase);
+}
+
+// Emit code for an expression node into the register at registerPosition,
+// using only that register and the ones above it. When an operation's
+// operands can't both fit in the registers left, the right operand is
+// spilled to the stack at spillAddress while the left one is evaluated.
+int emitExpressionNode(IOTunnel *tunnel,
+                       ExpressionNode *node,
+                       int registerPosition,
+                       int spillAddress) {
+    int available;
+    Instruction instruction;
+
+    // Every operation needs at least two registers, so this is only reached
+    // if an expression is started too close to the last register.
+    if (registerPosition >= REGISTER_COUNT ||
+        (node->right != NULL && registerPosition + 1 >= REGISTER_COUNT)) {
+
+        printError(ERROR_REGISTER_OUT_OF_BOUNDS, registerPosition + 1);
+
+        return SIGNAL_FAILURE;
+    }
+
+    // Literals and identifiers are loaded straight into the register.
+    if (node->left == NULL) {
+        setInstruction(&instruction, node->opCode, registerPosition, 0, node->value);
+
+        return emitInstruction(tunnel, instruction);
+    }
+
+    // Negations work in place.
+    if (node->right == NULL) {
+        if (emitExpressionNode(tunnel, node->left, registerPosition, spillAddress) == SIGNAL_FAILURE) {
+            return SIGNAL_FAILURE;
+        }
+        setInstruction(&instruction, NEG, registerPosition, registerPosition, 0);
+
+        return emitInstruction(tunnel, instruction);
+    }
+
+    available = REGISTER_COUNT - registerPosition;
+
+    // Evaluate the operand that needs more registers first, so that the
+    // other one has as many as possible left over. Ties go to the left
+    // operand, which is the order the operands are written in.
+    if (node->left->registers >= node->right->registers && node->right->registers < available) {
+        if (emitExpressionNode(tunnel, node->left, registerPosition, spillAddress) == SIGNAL_FAILURE ||
+            emitExpressionNode(tunnel, node->right, registerPosition + 1, spillAddress) == SIGNAL_FAILURE) {
+
+            return SIGNAL_FAILURE;
+        }
+        setInstruction(&instruction,
+                       node->opCode,
+                       registerPosition,
+                       registerPosition,
+                       registerPosition + 1);
+    }
+    else if (node->left->registers < node->right->registers && node->left->registers < available) {
+        if (emitExpressionNode(tunnel, node->right, registerPosition, spillAddress) == SIGNAL_FAILURE ||
+            emitExpressionNode(tunnel, node->left, registerPosition + 1, spillAddress) == SIGNAL_FAILURE) {
+
+            return SIGNAL_FAILURE;
+        }
+        setInstruction(&instruction,
+                       node->opCode,
+                       registerPosition,
+                       registerPosition + 1,
+                       registerPosition);
+    }
+
+    // Both operands need every register that is left, so the right operand
+    // is stored on the stack while the left one is evaluated, and loaded back
+    // for the operation.
+    else {
+        if (emitExpressionNode(tunnel, node->right, registerPosition, spillAddress) == SIGNAL_FAILURE) {
+            return SIGNAL_FAILURE;
+        }
+        setInstruction(&instruction, STO, registerPosition, 0, spillAddress);
+        if (emitInstruction(tunnel, instruction) == SIGNAL_FAILURE) {
+            return SIGNAL_FAILURE;
+        }
+
+        // Keep track of how many spill slots the activation record needs.
+        if (spillAddress + 1 - tunnel->spillBase > tunnel->spillSlots) {
+            tunnel->spillSlots = spillAddress + 1 - tunnel->spillBase;
+        }
+
+        if (emitExpressionNode(tunnel, node->left, registerPosition, spillAddress + 1) == SIGNAL_FAILURE) {
+            return SIGNAL_FAILURE;
+        }
+        setInstruction(&instruction, LOD, registerPosition + 1, 0, spillAddress);
+        if (emitInstruction(tunnel, instruction) == SIGNAL_FAILURE) {
+            return SIGNAL_FAILURE;
+        }
+        setInstruction(&instruction,
+                       node->opCode,
+                       registerPosition,
+                       registerPosition,
+                       registerPosition + 1);
+    }
+
+    return emitInstruction(tunnel, instruction);
+}
@@ -1,18 +1,33 @@
 // Part of Plum by Tiger Sachse.
 
-#include <stdlib.h>
 #include <limits.h>
 #include <string.h>
 #include "generator.h"
 
-// Create a new symbol table.
-SymbolTable *createSymbolTable(void)  {
+// Hash a name id into a slot of the table's index.
+#define HASH_SYMBOL_NAME(table, name) (((unsigned int) (name) * 2654435761u) & (table)->mask)
+
+// Create a new symbol table in the arena, naming symbols by ids from names.
+SymbolTable *createSymbolTable(Arena *arena, InternTable *names)  {
     SymbolTable *table;
 
-    if ((table = calloc(1, sizeof(SymbolTable))) == NULL) {
-        printError(ERROR_OUT_OF_MEMORY);
+    if ((table = allocateFromArena(arena, sizeof(SymbolTable))) == NULL) {
+        return NULL;
+    }
+
+    table->entries = allocateFromArena(arena, sizeof(Symbol) * INITIAL_SYMBOL_CAPACITY);
+    table->slots = allocateFromArena(arena, sizeof(SymbolSlot) * INITIAL_SYMBOL_CAPACITY * 2);
+    if (table->entries == NULL || table->slots == NULL) {
+        return NULL;
     }
-   
+
+    // Every slot starts out empty.
+    memset(table->slots, -1, sizeof(SymbolSlot) * INITIAL_SYMBOL_CAPACITY * 2);
+    table->capacity = INITIAL_SYMBOL_CAPACITY;
+    table->mask = INITIAL_SYMBOL_CAPACITY * 2 - 1;
+    table->names = names;
+    table->arena = arena;
+
     // This will be changed in the future. The offset was added to
     // allow printing some values that aren't necessary in this implementation
     // of a stack virtual machine.
@@ -21,141 +36,166 @@ SymbolTable *createSymbolTable(void)  {
     return table;
 }
 
-// Create a column for a symbol table.
-TableNode *createTableNode(int type,
-                           int value,
-                           int level,
-                           int active,
-                           int address,
-                           char *name,
-                           TableNode *next) {
-    TableNode *new;
-
-    // If the name is too long, return nothing.
-    if (strlen(name) > IDENTIFIER_LEN) {
-        printError(ERROR_IDENTIFIER_TOO_LARGE, name);
-        
-        return NULL;
-    }
+// Find the slot that belongs to name, or the empty slot where it would go.
+SymbolSlot *findSymbolSlot(SymbolTable *table, int name) {
+    unsigned int slot;
 
-    // If the call to malloc fails, return nothing.
-    if ((new = malloc(sizeof(TableNode))) == NULL) {
-        printError(ERROR_OUT_OF_MEMORY);
-        
-        return NULL;
+    slot = HASH_SYMBOL_NAME(table, name);
+    while (table->slots[slot].name != NO_NAME && table->slots[slot].name != name) {
+        slot = (slot + 1) & table->mask;
     }
 
-    // Set all the members of the new node.
-    new->next = next;
-    new->symbol.type = type;
-    new->symbol.value = value;
-    new->symbol.level = level;
-    new->symbol.active = active;
-    new->symbol.address = address;
-    strcpy(new->symbol.name, name);
+    return &table->slots[slot];
+}
+
+// Double the room for symbols, and rebuild the index to match. The old arrays
+// are left in the arena, which at most doubles the memory the table uses.
+int growSymbolTable(SymbolTable *table) {
+    int i;
+    Symbol *entries;
+    SymbolSlot *slots;
+    SymbolSlot *old;
+    int oldSlots;
+
+    entries = allocateFromArena(table->arena, sizeof(Symbol) * table->capacity * 2);
+    slots = allocateFromArena(table->arena, sizeof(SymbolSlot) * table->capacity * 4);
+    if (entries == NULL || slots == NULL) {
+        return SIGNAL_FAILURE;
+    }
+    memcpy(entries, table->entries, sizeof(Symbol) * table->symbols);
+    table->entries = entries;
+
+    // Move every taken slot over to the new index. Slots whose scope has
+    // been popped have nothing left to find, so they are dropped.
+    old = table->slots;
+    oldSlots = table->mask + 1;
+    memset(slots, -1, sizeof(SymbolSlot) * table->capacity * 4);
+    table->slots = slots;
+    table->capacity *= 2;
+    table->mask = table->capacity * 2 - 1;
+    for (i = 0; i < oldSlots; i++) {
+        if (old[i].name != NO_NAME && old[i].symbol != NO_SYMBOL) {
+            *findSymbolSlot(table, old[i].name) = old[i];
+        }
+    }
 
-    return new;
+    return SIGNAL_SUCCESS;
 }
 
-// Insert a new symbol column in the symbol table.
+// Insert a new symbol in the symbol table.
 int insertSymbol(SymbolTable *table,
                  int type,
                  int value,
                  int level,
                  int active,
-                 char *name) {
-    TableNode *new;
+                 int name) {
+    Symbol *new;
+    Symbol *existing;
+    SymbolSlot *slot;
 
     if (table == NULL) {
         printError(ERROR_NULL_POINTER);
-        
+
         return SIGNAL_FAILURE;
     }
 
-    // All entries in the symbol table must be unique.
-    if (lookupSymbol(table, name) != NULL) {
-        printError(ERROR_IDENTIFIER_ALREADY_DECLARED, name);
+    // Names must be unique within a level. A symbol may shadow one with the
+    // same name from an outer level.
+    if ((existing = lookupSymbol(table, name)) != NULL && existing->level == level) {
+        printError(ERROR_IDENTIFIER_ALREADY_DECLARED, getInternedName(table->names, name));
 
         return SIGNAL_FAILURE;
     }
 
-    new = createTableNode(type, value, level, active, table->currentAddress, name, table->head);
-    table->currentAddress++;
-
-    // If a new node could not be created, return failure.
-    if (new == NULL) {
-        printError(ERROR_OUT_OF_MEMORY);
-
+    if (table->symbols == table->capacity && growSymbolTable(table) == SIGNAL_FAILURE) {
         return SIGNAL_FAILURE;
     }
-    
-    // Set the head of the table to be the new node. The table is saved in reverse
-    // order using this scheme (like a stack). The old head is not forgotten
-    // because it was set as new's next pointer in the call to createTableNode.
-    else {
-        table->head = new;
-        table->symbols++;
-    
-        return SIGNAL_SUCCESS;
+
+    // Set all the members of the new symbol. It hides whatever the slot held
+    // for this name, which is restored when its scope is popped.
+    slot = findSymbolSlot(table, name);
+    new = &table->entries[table->symbols];
+    new->type = type;
+    new->value = value;
+    new->level = level;
+    new->active = active;
+    new->address = (type == LEX_CONST) ? 0 : table->currentAddress;
+    new->name = name;
+    new->shadowed = (slot->name == name) ? slot->symbol : NO_SYMBOL;
+
+    slot->name = name;
+    slot->symbol = table->symbols;
+    table->symbols++;
+
+    // Constants are compiled into the code as literals, so only variables
+    // take up room on the stack.
+    if (type != LEX_CONST) {
+        table->currentAddress++;
     }
+
+    return SIGNAL_SUCCESS;
 }
 
-// Hunt down a symbol in the table.
-Symbol *lookupSymbol(SymbolTable *table, char *name) {
-    TableNode *current;
+// Hunt down the innermost active symbol with the given name. Names are
+// interned, so comparing ids is the same as comparing names.
+Symbol *lookupSymbol(SymbolTable *table, int name) {
+    int index;
+    SymbolSlot *slot;
 
     if (table == NULL) {
         printError(ERROR_NULL_POINTER);
-        
+
         return NULL;
     }
 
-    current = table->head;
-    while (current != NULL) {
-        
-        // Skip inactive entries if necessary.
-        if (current->symbol.active == STATUS_INACTIVE) {
-            current = current->next;
-        }
-        
-        // Return a pointer to the symbol if the name matches.
-        else if (strcmp(current->symbol.name, name) == 0) {
-            return &(current->symbol);
-        }
-        
-        // Go to the next column in the table.
-        else {
-            current = current->next;
-        }
+    // The symbol was never declared, so return nothing.
+    slot = findSymbolSlot(table, name);
+    if (slot->name != name) {
+        return NULL;
+    }
+
+    // Skip inactive entries, falling back to the ones they shadow.
+    index = slot->symbol;
+    while (index != NO_SYMBOL && table->entries[index].active == STATUS_INACTIVE) {
+        index = table->entries[index].shadowed;
     }
 
-    // The symbol was not in the table, so return nothing.
-    return NULL; 
+    return (index == NO_SYMBOL) ? NULL : &table->entries[index];
 }
 
-// Get the size of the table.
-int getTableSize(SymbolTable *table) {
-    return (table == NULL) ? 0 : table->symbols;
+// Enter a new, nested scope.
+void pushScope(SymbolTable *table) {
+    if (table == NULL) {
+        printError(ERROR_NULL_POINTER);
+
+        return;
+    }
+
+    table->level++;
 }
 
-// Free all memory associated with the table.
-void destroySymbolTable(SymbolTable *table) {
-    TableNode *next;
-    TableNode *current;
+// Leave the current scope. Its symbols stay in the table, so they are still
+// printed, but become inactive, and the names they shadowed are visible again.
+void popScope(SymbolTable *table) {
+    int i;
 
     if (table == NULL) {
         printError(ERROR_NULL_POINTER);
-        
+
         return;
     }
 
-    // Delete all the nodes.
-    current = table->head;
-    while (current != NULL) {
-        next = current->next;
-        free(current);
-        current = next;
+    if (table->level == 0) {
+        return;
+    }
+
+    // Scopes nest, so the symbols of the current scope are the newest ones.
+    for (i = table->symbols - 1; i >= 0 && table->entries[i].level >= table->level; i--) {
+        if (table->entries[i].active == STATUS_ACTIVE) {
+            table->entries[i].active = STATUS_INACTIVE;
+            findSymbolSlot(table, table->entries[i].name)->symbol = table->entries[i].shadowed;
+        }
     }
 
-    free(table);
+    table->level--;
 }
@@ -1,44 +1,37 @@
 // Part of Plum by Tiger Sachse.
 
 #include <stdlib.h>
+#include <string.h>
 #include "generator.h"
 
-// Create an IOTunnel to manage the input and output streams of the parser.
-IOTunnel *createIOTunnel(char *lexemeFile, char *outFile) {
+// Create an IOTunnel in the arena that reads tokens from lexemes and collects
+// the emitted instructions in memory.
+IOTunnel *createIOTunnel(Arena *arena, LexemeList *lexemes) {
     IOTunnel *tunnel;
 
-    // Create the tunnel container.
-    if ((tunnel = calloc(1, sizeof(IOTunnel))) == NULL) {
-        printError(ERROR_OUT_OF_MEMORY);
+    if (lexemes == NULL) {
+        printError(ERROR_NULL_POINTER);
 
         return NULL;
     }
 
-    // Attempt to open the input file.
-    if ((tunnel->fin = fopen(lexemeFile, "r")) == NULL) {
-        printError(ERROR_FILE_NOT_FOUND, lexemeFile);
-        free(tunnel);
-
+    // Create the tunnel container.
+    if ((tunnel = allocateFromArena(arena, sizeof(IOTunnel))) == NULL) {
         return NULL;
     }
 
-    // Attempt to open the output file.
-    if ((tunnel->fout = fopen(outFile, "w")) == NULL) {
-        printError(ERROR_FILE_NOT_FOUND, outFile);
-        fclose(tunnel->fin);
-        free(tunnel);
+    // Create the array that holds every emitted instruction. It outlives the
+    // arena, so it is allocated on its own.
+    if ((tunnel->code = malloc(sizeof(Instruction) * INITIAL_CODE_CAPACITY)) == NULL) {
+        printError(ERROR_OUT_OF_MEMORY);
 
         return NULL;
     }
 
-    // Create an empty instruction queue used for nested statements.
-    if ((tunnel->queue = createInstructionQueue()) == NULL) {
-        fclose(tunnel->fin);
-        fclose(tunnel->fout);
-        free(tunnel);
-
-        return NULL;
-    }
+    tunnel->lexemes = lexemes;
+    tunnel->arena = arena;
+    tunnel->codeCapacity = INITIAL_CODE_CAPACITY;
+    tunnel->tokenName = NO_NAME;
 
     // Set the tunnel's internal status to success.
     tunnel->status = SIGNAL_SUCCESS;
@@ -46,127 +39,85 @@ IOTunnel *createIOTunnel(char *lexemeFile, char *outFile) {
     return tunnel;
 }
 
-// Send a given instruction either to file or into the queue.
-int emitInstruction(IOTunnel *tunnel, Instruction instruction, int nestedDepth) {
-    if (tunnel == NULL || tunnel->queue == NULL) {
+// Append an instruction to the code array, which doubles in size whenever it
+// fills up.
+int emitInstruction(IOTunnel *tunnel, Instruction instruction) {
+    Instruction *grown;
+
+    if (tunnel == NULL || tunnel->code == NULL) {
         printError(ERROR_NULL_POINTER);
 
         return SIGNAL_FAILURE;
     }
 
-    // If this is a nested instruction, then it goes into the queue.
-    if (nestedDepth > 0) {
-        if (enqueueInstruction(tunnel->queue, instruction) == SIGNAL_FAILURE) {
-            return SIGNAL_FAILURE;
-        } 
-    }
+    if (tunnel->programCounter == tunnel->codeCapacity) {
+        grown = realloc(tunnel->code, sizeof(Instruction) * tunnel->codeCapacity * 2);
+        if (grown == NULL) {
+            printError(ERROR_OUT_OF_MEMORY);
 
-    // Else the instruction is printed to the output file.
-    else {
-        if (fprintf(tunnel->fout, "%d %d %d %d\n",
-                    instruction.opCode,
-                    instruction.RField,
-                    instruction.LField,
-                    instruction.MField) <= 0) {
-            printError(ERROR_WRITING_FILE_FAILED);
-            
             return SIGNAL_FAILURE;
         }
-        else {
-
-            // Increase the tunnel's program counter for each instruction
-            // printed to file.
-            tunnel->programCounter++;
 
-            return SIGNAL_SUCCESS;
-        }
+        tunnel->code = grown;
+        tunnel->codeCapacity *= 2;
     }
-}
 
-// Emit all of the instructions in the queue in order, until empty.
-int emitInstructions(IOTunnel *tunnel) {
-    int returnValue;
-    QueueNode *current;
-
-    if (tunnel == NULL || tunnel->queue == NULL) {
-        printError(ERROR_NULL_POINTER);
+    // Increase the tunnel's program counter for each instruction emitted.
+    tunnel->code[tunnel->programCounter++] = instruction;
 
-        return SIGNAL_FAILURE;
+    // Give the peephole optimizer a look at the new instruction.
+    if (tunnel->optimize) {
+        optimizeTail(tunnel);
     }
-  
-    returnValue = SIGNAL_SUCCESS;
 
-    // Emit each instruction, starting at the head of the queue. Delete
-    // the nodes along the way.
-    current = tunnel->queue->head;
-    while (current != NULL) { 
-        
-        // If any call to emitInstruction fails, then change the returnValue to
-        // failure. Note that this doesn't just return failure immediately, else
-        // the rest of the queue would never get deleted, resulting in a memory leak.
-        if (emitInstruction(tunnel, current->instruction, 0) == SIGNAL_FAILURE) {
-            returnValue = SIGNAL_FAILURE;
-        }
-
-        current = current->next;
-    }
-
-    // Clear out the queue. I know this could have been done as the instructions
-    // were emitted, but this is more organized and modular.
-    clearInstructionQueue(tunnel->queue);
-
-    return returnValue;
+    return SIGNAL_SUCCESS;
 }
 
-// Emit instructions for all the constants in the symbol table.
-int setConstants(IOTunnel *tunnel, SymbolTable *table) {
-    TableNode *current;
+// Emit a forward jump whose target isn't known yet. Returns the address of
+// the jump, to be given to patchJumpTarget() once the target is known.
+int emitJumpPlaceholder(IOTunnel *tunnel, int opCode) {
     Instruction instruction;
 
-    if (tunnel == NULL || table == NULL) {
-        printError(ERROR_NULL_POINTER);
-        
+    setInstruction(&instruction, opCode, 0, 0, 0);
+    if (emitInstruction(tunnel, instruction) == SIGNAL_FAILURE) {
         return SIGNAL_FAILURE;
     }
-    
-    current = table->head;
-    while (current != NULL) {
-
-        // If the current symbol is a constant, emit a LIT and STO instruction.
-        if (current->symbol.type == LEX_CONST) {
-            setInstruction(&instruction, LIT, 0, 0, current->symbol.value);
-            if (emitInstruction(tunnel, instruction, 0) == SIGNAL_FAILURE) {
-                return SIGNAL_FAILURE;
-            }
-            setInstruction(&instruction, STO, 0, 0, current->symbol.address);
-            if (emitInstruction(tunnel, instruction, 0) == SIGNAL_FAILURE) {
-                return SIGNAL_FAILURE;
-            }
-        }
 
-        current = current->next;
+    // The jump must stay where it is to be patched.
+    tunnel->barrier = tunnel->programCounter;
+
+    return tunnel->programCounter - 1;
+}
+
+// Point the jump at address to target.
+void patchJumpTarget(IOTunnel *tunnel, int address, int target) {
+    if (tunnel == NULL || address < 0 || address >= tunnel->programCounter) {
+        printError(ERROR_PROGRAM_COUNTER_OUT_OF_BOUNDS, address);
+
+        return;
     }
 
-    return SIGNAL_SUCCESS;
+    tunnel->code[address].MField = target;
 }
 
-// Return the tail of the instruction queue.
-QueueNode *getQueueTail(IOTunnel *tunnel) {
-    return (tunnel == NULL || tunnel->queue == NULL) ? NULL : tunnel->queue->tail;
+// Get the address of the next instruction as the target of a jump. The
+// peephole optimizer won't rewrite anything before it, so that the
+// instruction found there is still the one the jump expects.
+int markJumpTarget(IOTunnel *tunnel) {
+    tunnel->barrier = tunnel->programCounter;
+
+    return tunnel->programCounter;
 }
 
-// Load a token from the input stream.
+// Load the next token from the lexeme list.
 int loadToken(IOTunnel *tunnel) {
-    int i;
-    char buffer;
-    
-    if (tunnel == NULL) {
+    if (tunnel == NULL || tunnel->lexemes == NULL) {
         printError(ERROR_NULL_POINTER);
         
         return SIGNAL_FAILURE;
     }
 
-    // If the input tunnel is done, then we've reached the end of the file unexpectedly.
+    // If the input tunnel is done, then we've reached the end of the list unexpectedly.
     if (tunnel->status == SIGNAL_EOF) {
         printError(ERROR_UNEXPECTED_END_OF_FILE);
         tunnel->status = SIGNAL_FAILURE;
@@ -174,24 +125,16 @@ int loadToken(IOTunnel *tunnel) {
         return SIGNAL_FAILURE;
     }
 
-    // Read the next token and the buffer behind it in the input file.
-    if (fscanf(tunnel->fin, " %d%c", &(tunnel->token), &buffer) == EOF) {
+    // At the end of the list the previous token is left in place and the
+    // status becomes EOF, so that only the next call fails.
+    if (tunnel->lexemeIndex >= tunnel->lexemes->count) {
         tunnel->status = SIGNAL_EOF;
     }
- 
-    // If the token wasn't followed by whitespace, then the input file is
-    // formatted incorrectly. There is a slight bug in this code: if we are nearly
-    // at the end of the file then the buffer could be loaded with some external
-    // junk value. This is usually zero but not always. In this instance it seems
-    // relatively inconsequential.
-    if (!isWhitespace(buffer)) {
-        printError(ERROR_ILLEGAL_LEXEME_FORMAT, tunnel->token);
-        tunnel->status = SIGNAL_FAILURE;
-        
-        return SIGNAL_FAILURE;
+    else {
+        tunnel->token = tunnel->lexemes->lexemes[tunnel->lexemeIndex++].token;
     }
 
-    // Handle identifiers appropriately, or erase the tokenName for all
+    // Handle identifiers appropriately, or clear the tokenName for all
     // other tokens.
     if (tunnel->token == LEX_IDENTIFIER) {
         if (handleIdentifier(tunnel) == SIGNAL_FAILURE) {
@@ -199,7 +142,7 @@ int loadToken(IOTunnel *tunnel) {
         }
     }
     else {
-        tunnel->tokenName[0] = '\0';
+        tunnel->tokenName = NO_NAME;
     }
    
     // Handle numbers appropriately or default the tokenValue to zero
@@ -213,10 +156,10 @@ int loadToken(IOTunnel *tunnel) {
         tunnel->tokenValue = 0;
     }
 
-    // If we didn't reach the end of the file at some point in the function, set
-    // the internal tunnel status to success, else it will remain as EOF. This
-    // means that the next time this function is called the function will know
-    // that the EOF has been reached before.
+    // If we didn't reach the end of the list, set the internal tunnel status
+    // to success, else it will remain as EOF. This means that the next time
+    // this function is called the function will know that the end has been
+    // reached before.
     if (tunnel->status != SIGNAL_EOF) {
         tunnel->status = SIGNAL_SUCCESS;
     }
@@ -226,78 +169,20 @@ int loadToken(IOTunnel *tunnel) {
 
 // Handle identifiers in the lexeme list.
 int handleIdentifier(IOTunnel *tunnel) {
-    char buffer;
-    int i;
-
     if (tunnel == NULL) {
         printError(ERROR_NULL_POINTER);
 
         return SIGNAL_FAILURE;
     }
 
-    // If the input file is through, we've got a problem.
+    // If the list is through, we've got a problem.
     if (tunnel->status == SIGNAL_EOF) {
         printError(ERROR_IDENTIFIER_EXPECTED);
         
         return SIGNAL_FAILURE;
     }
 
-    // Absorb an appropriate amount of characters.
-    for (i = 0; i < IDENTIFIER_LEN; i++) {
-
-        // If the file ends, adjust the tokenName.
-        if (fscanf(tunnel->fin, "%c", tunnel->tokenName + i) == EOF) {
-            tunnel->tokenName[i] = '\0';
-
-            // If no tokens were added, then the tokenName is missing.
-            if (i == 0) {
-                printError(ERROR_IDENTIFIER_EXPECTED);
-                tunnel->status = SIGNAL_FAILURE;
-                
-                return SIGNAL_FAILURE;
-            }
-
-            tunnel->status = SIGNAL_EOF;
-        }
-
-        // If the most recent character is not an alphanumeric character, then
-        // the identifier has ended.
-        if (!isAlphanumeric(tunnel->tokenName[i])) {
-            fseek(tunnel->fin, -1, SEEK_CUR);
-
-            if (!isWhitespace(tunnel->tokenName[i])) {
-                tunnel->tokenName[i] = '\0';
-                printError(ERROR_ILLEGAL_IDENTIFIER, tunnel->tokenName);
-                tunnel->status = SIGNAL_FAILURE;
-
-                return SIGNAL_FAILURE;
-            }
-            else {
-                if (i == 0) {
-                    printError(ERROR_IDENTIFIER_EXPECTED);
-                    tunnel->status = SIGNAL_FAILURE;
-
-                    return SIGNAL_FAILURE;
-                }
-                tunnel->tokenName[i] = '\0';
-                break;
-            }
-        }
-    }
-
-    // If, after running out of characters in the loop, there's still more
-    // alphanumeric characters, then the token is too long.
-    if (fscanf(tunnel->fin, "%c", &buffer) != EOF && isAlphanumeric(buffer)) {
-        printError(ERROR_IDENTIFIER_TOO_LARGE, tunnel->tokenName);
-        tunnel->status = SIGNAL_FAILURE;
-
-        return SIGNAL_FAILURE;
-    }
-    else {
-        fseek(tunnel->fin, -1, SEEK_CUR);
-    }
-
-    tunnel->status = SIGNAL_SUCCESS;
+    tunnel->tokenName = tunnel->lexemes->lexemes[tunnel->lexemeIndex - 1].name;
 
     return SIGNAL_SUCCESS;
 }
@@ -310,35 +195,34 @@ int handleNumber(IOTunnel *tunnel) {
         return SIGNAL_FAILURE;
     }
     
-    // If the input file is through, we've got a problem.
+    // If the list is through, we've got a problem.
     if (tunnel->status == SIGNAL_EOF) {
         printError(ERROR_NUMBER_EXPECTED);
         
         return SIGNAL_FAILURE;
     }
 
-    // If the expected number isn't there, throw a missing token error.
-    if (fscanf(tunnel->fin, " %d", &(tunnel->tokenValue)) == EOF) {
-        printError(ERROR_NUMBER_EXPECTED);
-       tunnel->status = SIGNAL_FAILURE;
+    tunnel->tokenValue = tunnel->lexemes->lexemes[tunnel->lexemeIndex - 1].value;
 
-       return SIGNAL_FAILURE;
-    }
-    else {
-        tunnel->status = SIGNAL_SUCCESS;
-        
-        return SIGNAL_SUCCESS;
+    return SIGNAL_SUCCESS;
+}
+
+// Get the text of the current identifier, for error messages.
+char *getTokenName(IOTunnel *tunnel) {
+    if (tunnel == NULL || tunnel->lexemes == NULL) {
+        return "";
     }
+
+    return getInternedName(tunnel->lexemes->names, tunnel->tokenName);
 }
 
-// Destroy the IOTunnel.
+// Destroy the IOTunnel's code. Everything else in the tunnel belongs to its
+// arena, and the lexeme list belongs to the caller.
 void destroyIOTunnel(IOTunnel *tunnel) {
     if (tunnel == NULL) {
         return;
     }
 
-    fclose(tunnel->fin);
-    fclose(tunnel->fout);
-    destroyInstructionQueue(tunnel->queue);
-    free(tunnel);
+    free(tunnel->code);
+    tunnel->code = NULL;
 }
@@ -0,0 +1,143 @@
+// Part of Plum by Tiger Sachse.
+
+#include <stdlib.h>
+#include <string.h>
+#include "plum.h"
+
+// Create an empty intern table.
+InternTable *createInternTable(void) {
+    InternTable *table;
+
+    if ((table = malloc(sizeof(InternTable))) == NULL) {
+        printError(ERROR_OUT_OF_MEMORY);
+
+        return NULL;
+    }
+
+    table->names = malloc(sizeof(InternedName) * INITIAL_INTERN_CAPACITY);
+    table->slots = malloc(sizeof(int) * INITIAL_INTERN_CAPACITY * 2);
+    if (table->names == NULL || table->slots == NULL) {
+        free(table->names);
+        free(table->slots);
+        free(table);
+        printError(ERROR_OUT_OF_MEMORY);
+
+        return NULL;
+    }
+
+    // Empty slots hold NO_NAME.
+    memset(table->slots, -1, sizeof(int) * INITIAL_INTERN_CAPACITY * 2);
+    table->count = 0;
+    table->capacity = INITIAL_INTERN_CAPACITY;
+    table->mask = INITIAL_INTERN_CAPACITY * 2 - 1;
+
+    return table;
+}
+
+// Hash the first length characters of text (FNV-1a).
+unsigned int hashName(char *text, int length) {
+    int i;
+    unsigned int hash;
+
+    hash = FNV_OFFSET_BASIS;
+    for (i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char) text[i]) * FNV_PRIME;
+    }
+
+    return hash;
+}
+
+// Return the id of the first length characters of text, adding them to the
+// table if they haven't been seen before. The text doesn't need to be
+// terminated, and anything past IDENTIFIER_LEN characters is ignored.
+int internName(InternTable *table, char *text, int length) {
+    int i;
+    int slot;
+    int *slots;
+    InternedName *name;
+    InternedName *grown;
+
+    if (table == NULL || text == NULL) {
+        printError(ERROR_NULL_POINTER);
+
+        return SIGNAL_FAILURE;
+    }
+
+    if (length > IDENTIFIER_LEN) {
+        length = IDENTIFIER_LEN;
+    }
+
+    for (slot = hashName(text, length) & table->mask;
+         table->slots[slot] != NO_NAME;
+         slot = (slot + 1) & table->mask) {
+
+        name = &table->names[table->slots[slot]];
+        if (name->length == length && memcmp(name->text, text, length) == 0) {
+            return table->slots[slot];
+        }
+    }
+
+    // The name is new. When the table is full, both the names and the slots
+    // double, and every name is placed in the new slots again.
+    if (table->count == table->capacity) {
+        if ((grown = realloc(table->names, sizeof(InternedName) * table->capacity * 2)) == NULL) {
+            printError(ERROR_OUT_OF_MEMORY);
+
+            return SIGNAL_FAILURE;
+        }
+        table->names = grown;
+
+        if ((slots = malloc(sizeof(int) * table->capacity * 4)) == NULL) {
+            printError(ERROR_OUT_OF_MEMORY);
+
+            return SIGNAL_FAILURE;
+        }
+        free(table->slots);
+        table->slots = slots;
+        table->capacity *= 2;
+        table->mask = table->capacity * 2 - 1;
+
+        memset(table->slots, -1, sizeof(int) * table->capacity * 2);
+        for (i = 0; i < table->count; i++) {
+            for (slot = hashName(table->names[i].text, table->names[i].length) & table->mask;
+                 table->slots[slot] != NO_NAME;
+                 slot = (slot + 1) & table->mask) {
+            }
+            table->slots[slot] = i;
+        }
+
+        for (slot = hashName(text, length) & table->mask;
+             table->slots[slot] != NO_NAME;
+             slot = (slot + 1) & table->mask) {
+        }
+    }
+
+    name = &table->names[table->count];
+    name->length = length;
+    memcpy(name->text, text, length);
+    name->text[length] = '\0';
+    table->slots[slot] = table->count;
+
+    return table->count++;
+}
+
+// Get the text of an interned name. Anything that isn't an id in the table,
+// including NO_NAME, has empty text.
+char *getInternedName(InternTable *table, int id) {
+    if (table == NULL || id < 0 || id >= table->count) {
+        return "";
+    }
+
+    return table->names[id].text;
+}
+
+// Free an intern table.
+void destroyInternTable(InternTable *table) {
+    if (table == NULL) {
+        return;
+    }
+
+    free(table->names);
+    free(table->slots);
+    free(table);
+}
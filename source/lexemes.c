@@ -0,0 +1,563 @@
+// Part of Plum by Tiger Sachse.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "plum.h"
+
+// Create an empty lexeme list.
+LexemeList *createLexemeList(void) {
+    LexemeList *list;
+
+    if ((list = malloc(sizeof(LexemeList))) == NULL) {
+        printError(ERROR_OUT_OF_MEMORY);
+
+        return NULL;
+    }
+
+    if ((list->lexemes = malloc(sizeof(Lexeme) * INITIAL_LEXEME_CAPACITY)) == NULL) {
+        free(list);
+        printError(ERROR_OUT_OF_MEMORY);
+
+        return NULL;
+    }
+
+    if ((list->names = createInternTable()) == NULL) {
+        free(list->lexemes);
+        free(list);
+
+        return NULL;
+    }
+
+    list->count = 0;
+    list->capacity = INITIAL_LEXEME_CAPACITY;
+
+    return list;
+}
+
+// Append a lexeme to the end of the list, growing it if needed. The name is
+// an id from the list's intern table, or NO_NAME for tokens that carry no text.
+int appendLexeme(LexemeList *list, int token, int value, int name) {
+    Lexeme *grown;
+    Lexeme *lexeme;
+
+    if (list == NULL) {
+        printError(ERROR_NULL_POINTER);
+
+        return SIGNAL_FAILURE;
+    }
+
+    if (list->count == list->capacity) {
+        if ((grown = realloc(list->lexemes, sizeof(Lexeme) * list->capacity * 2)) == NULL) {
+            printError(ERROR_OUT_OF_MEMORY);
+
+            return SIGNAL_FAILURE;
+        }
+
+        list->lexemes = grown;
+        list->capacity *= 2;
+    }
+
+    lexeme = &list->lexemes[list->count++];
+    lexeme->token = token;
+    lexeme->value = value;
+    lexeme->name = name;
+
+    return SIGNAL_SUCCESS;
+}
+
+// Get the text of a lexeme from the list, which is empty for lexemes without
+// a name.
+char *getLexemeName(LexemeList *list, Lexeme *lexeme) {
+    if (list == NULL || lexeme == NULL) {
+        return "";
+    }
+
+    return getInternedName(list->names, lexeme->name);
+}
+
+// Read the identifier that follows an identifier token in a lexeme file.
+int loadLexemeName(FILE *f, char *name) {
+    int i;
+    int character;
+
+    // Skip the whitespace between the token and its name.
+    while ((character = fgetc(f)) != EOF && isWhitespace(character)) {
+    }
+
+    // Absorb an appropriate amount of characters.
+    for (i = 0; i < IDENTIFIER_LEN && character != EOF && isAlphanumeric(character); i++) {
+        name[i] = character;
+        character = fgetc(f);
+    }
+    name[i] = '\0';
+
+    if (i == 0 && (character == EOF || isWhitespace(character))) {
+        printError(ERROR_IDENTIFIER_EXPECTED);
+
+        return SIGNAL_FAILURE;
+    }
+
+    // If there's still more alphanumeric characters, then the token is too long.
+    if (character != EOF && isAlphanumeric(character)) {
+        printError(ERROR_IDENTIFIER_TOO_LARGE, name);
+
+        return SIGNAL_FAILURE;
+    }
+
+    // The identifier must end at whitespace or the end of the file.
+    if (character != EOF && !isWhitespace(character)) {
+        printError(ERROR_ILLEGAL_IDENTIFIER, name);
+
+        return SIGNAL_FAILURE;
+    }
+
+    return SIGNAL_SUCCESS;
+}
+
+// Load a lexeme file written by writeLexemeList() into a new list. Binary
+// lexeme files are handed to loadLexemeStream().
+LexemeList *loadLexemeList(char *filename) {
+    FILE *f;
+    int token;
+    int value;
+    int nameId;
+    int character;
+    int returnValue;
+    LexemeList *list;
+    char name[IDENTIFIER_LEN + 1];
+
+    if (filename == NULL) {
+        printError(ERROR_NULL_POINTER);
+
+        return NULL;
+    }
+
+    if (isLexemeFile(filename)) {
+        return loadLexemeStream(filename);
+    }
+
+    if ((f = fopen(filename, "r")) == NULL) {
+        printError(ERROR_FILE_NOT_FOUND, filename);
+
+        return NULL;
+    }
+
+    if ((list = createLexemeList()) == NULL) {
+        fclose(f);
+
+        return NULL;
+    }
+
+    returnValue = SIGNAL_SUCCESS;
+    while (returnValue == SIGNAL_SUCCESS && fscanf(f, " %d", &token) == 1) {
+        name[0] = '\0';
+        value = 0;
+
+        // If the token wasn't followed by whitespace, then the input file is
+        // formatted incorrectly.
+        if ((character = fgetc(f)) != EOF && !isWhitespace(character)) {
+            printError(ERROR_ILLEGAL_LEXEME_FORMAT, token);
+            returnValue = SIGNAL_FAILURE;
+        }
+        else if (token == LEX_IDENTIFIER) {
+            returnValue = loadLexemeName(f, name);
+        }
+        else if (token == LEX_NUMBER) {
+            if (fscanf(f, " %d", &value) != 1) {
+                printError(ERROR_NUMBER_EXPECTED);
+                returnValue = SIGNAL_FAILURE;
+            }
+            else {
+                snprintf(name, sizeof(name), "%d", value);
+            }
+        }
+
+        // Identifiers and numbers are interned, so equal names share an id.
+        nameId = NO_NAME;
+        if (returnValue == SIGNAL_SUCCESS && name[0] != '\0') {
+            if ((nameId = internName(list->names, name, strlen(name))) == SIGNAL_FAILURE) {
+                returnValue = SIGNAL_FAILURE;
+            }
+        }
+
+        if (returnValue == SIGNAL_SUCCESS) {
+            returnValue = appendLexeme(list, token, value, nameId);
+        }
+    }
+
+    // Anything left that isn't a token means the file is malformed.
+    if (returnValue == SIGNAL_SUCCESS && !feof(f)) {
+        printError(ERROR_ILLEGAL_LEXEME_FORMAT, LEX_UNKNOWN);
+        returnValue = SIGNAL_FAILURE;
+    }
+
+    fclose(f);
+
+    if (returnValue == SIGNAL_FAILURE) {
+        destroyLexemeList(list);
+
+        return NULL;
+    }
+
+    return list;
+}
+
+// Format a lexeme from the list at buffer exactly as it appears in a text
+// lexeme file, and return its length. The buffer needs room for
+// MAX_LEXEME_TEXT_LENGTH bytes.
+int formatLexeme(char *buffer, LexemeList *list, Lexeme *lexeme) {
+    int length;
+    int digits;
+    unsigned int token;
+    char *name;
+    char reversed[12];
+
+    length = 0;
+    token = lexeme->token;
+    if (lexeme->token < 0) {
+        buffer[length++] = '-';
+        token = 0u - token;
+    }
+
+    // Write out the digits of the token, least significant first, then flip them.
+    digits = 0;
+    do {
+        reversed[digits++] = '0' + token % 10;
+        token /= 10;
+    } while (token > 0);
+    while (digits > 0) {
+        buffer[length++] = reversed[--digits];
+    }
+    buffer[length++] = ' ';
+
+    // Identifiers and numbers are followed by their text.
+    if (lexeme->token == LEX_IDENTIFIER || lexeme->token == LEX_NUMBER) {
+        for (name = getLexemeName(list, lexeme); *name != '\0'; name++) {
+            buffer[length++] = *name;
+        }
+        buffer[length++] = ' ';
+    }
+
+    return length;
+}
+
+// Write the list to filename as text, one token after another, with
+// identifiers and numbers followed by their text. Binary output is handed
+// to writeLexemeStream() when requested in the options.
+int writeLexemeList(LexemeList *list, char *filename, int options) {
+    int i;
+    FILE *f;
+    int length;
+    int returnValue;
+    char buffer[LEXEME_WRITE_BUFFER_SIZE];
+
+    if (list == NULL || filename == NULL) {
+        printError(ERROR_NULL_POINTER);
+
+        return SIGNAL_FAILURE;
+    }
+
+    if (checkOption(&options, OPTION_BINARY_BYTECODE)) {
+        return writeLexemeStream(list, filename);
+    }
+
+    if ((f = fopen(filename, "w")) == NULL) {
+        printError(ERROR_FILE_NOT_FOUND, filename);
+
+        return SIGNAL_FAILURE;
+    }
+
+    // Lexemes are formatted into a buffer that is written out whenever it
+    // might not fit another one.
+    returnValue = SIGNAL_SUCCESS;
+    length = 0;
+    for (i = 0; i < list->count && returnValue == SIGNAL_SUCCESS; i++) {
+        length += formatLexeme(buffer + length, list, &list->lexemes[i]);
+
+        if (length > LEXEME_WRITE_BUFFER_SIZE - MAX_LEXEME_TEXT_LENGTH || i == list->count - 1) {
+            if (fwrite(buffer, 1, length, f) != (size_t) length) {
+                returnValue = SIGNAL_FAILURE;
+            }
+            length = 0;
+        }
+    }
+
+    if (fclose(f) != 0 || returnValue == SIGNAL_FAILURE) {
+        printError(ERROR_WRITING_FILE_FAILED);
+
+        return SIGNAL_FAILURE;
+    }
+
+    return SIGNAL_SUCCESS;
+}
+
+// Write the list to filename as a binary lexeme stream. The stream is:
+//
+//   header:  magic, version, lexeme count, name count, and checksum words
+//   names:   each distinct identifier once, as a length byte and its characters
+//   records: a token for every lexeme, followed by the name index of an
+//            identifier or the value of a number
+//
+// Header words are little-endian and everything in a record is a varint (see
+// encodeVarint()), so the stream is the same on every machine and most lexemes
+// take a single byte. The checksum covers everything after the header.
+int writeLexemeStream(LexemeList *list, char *filename) {
+    FILE *f;
+    int i;
+    int id;
+    int length;
+    int nameCount;
+    int *indexOf;
+    int *idOf;
+    long size;
+    unsigned char *stream;
+    unsigned char *cursor;
+    char *name;
+
+    if (list == NULL || filename == NULL) {
+        printError(ERROR_NULL_POINTER);
+
+        return SIGNAL_FAILURE;
+    }
+
+    // Map interned ids to stream indices, and back again.
+    indexOf = malloc(sizeof(int) * (list->names->count + 1));
+    idOf = malloc(sizeof(int) * (list->names->count + 1));
+    if (indexOf == NULL || idOf == NULL) {
+        free(indexOf);
+        free(idOf);
+        printError(ERROR_OUT_OF_MEMORY);
+
+        return SIGNAL_FAILURE;
+    }
+
+    // Give each distinct identifier an index, in order of first use. Number
+    // text is interned too, but isn't part of the stream.
+    memset(indexOf, -1, sizeof(int) * (list->names->count + 1));
+    nameCount = 0;
+    size = LEXEME_HEADER_SIZE + (long) list->count * LEXEME_MAX_RECORD_SIZE;
+    for (i = 0; i < list->count; i++) {
+        id = list->lexemes[i].name;
+        if (list->lexemes[i].token == LEX_IDENTIFIER && indexOf[id] == -1) {
+            indexOf[id] = nameCount;
+            idOf[nameCount++] = id;
+            size += 1 + list->names->names[id].length;
+        }
+    }
+
+    if ((stream = malloc(size)) == NULL) {
+        free(indexOf);
+        free(idOf);
+        printError(ERROR_OUT_OF_MEMORY);
+
+        return SIGNAL_FAILURE;
+    }
+
+    // Lay out the names and records after the header.
+    cursor = stream + LEXEME_HEADER_SIZE;
+    for (i = 0; i < nameCount; i++) {
+        name = list->names->names[idOf[i]].text;
+        length = list->names->names[idOf[i]].length;
+        *cursor++ = length;
+        memcpy(cursor, name, length);
+        cursor += length;
+    }
+    for (i = 0; i < list->count; i++) {
+        cursor += encodeVarint(cursor, list->lexemes[i].token);
+        if (list->lexemes[i].token == LEX_IDENTIFIER) {
+            cursor += encodeVarint(cursor, indexOf[list->lexemes[i].name]);
+        }
+        else if (list->lexemes[i].token == LEX_NUMBER) {
+            cursor += encodeVarint(cursor, list->lexemes[i].value);
+        }
+    }
+    size = cursor - stream;
+
+    memcpy(stream, LEXEME_MAGIC, LEXEME_MAGIC_LENGTH);
+    encodeWord(stream + 4, LEXEME_VERSION);
+    encodeWord(stream + 8, list->count);
+    encodeWord(stream + 12, nameCount);
+    encodeWord(stream + 16, checksumBytes(FNV_OFFSET_BASIS,
+                                          stream + LEXEME_HEADER_SIZE,
+                                          size - LEXEME_HEADER_SIZE));
+
+    free(indexOf);
+    free(idOf);
+
+    if ((f = fopen(filename, "wb")) == NULL) {
+        free(stream);
+        printError(ERROR_FILE_NOT_FOUND, filename);
+
+        return SIGNAL_FAILURE;
+    }
+
+    if (fwrite(stream, 1, size, f) != (size_t) size) {
+        fclose(f);
+        free(stream);
+        printError(ERROR_WRITING_FILE_FAILED);
+
+        return SIGNAL_FAILURE;
+    }
+
+    free(stream);
+    if (fclose(f) != 0) {
+        printError(ERROR_WRITING_FILE_FAILED);
+
+        return SIGNAL_FAILURE;
+    }
+
+    return SIGNAL_SUCCESS;
+}
+
+// Load a binary lexeme stream written by writeLexemeStream() into a new list.
+// The whole file is read at once, checked, and then decoded.
+LexemeList *loadLexemeStream(char *filename) {
+    FILE *f;
+    int i;
+    int token;
+    int index;
+    int value;
+    int nameId;
+    int nameCount;
+    int lexemeCount;
+    long size;
+    unsigned char *stream;
+    unsigned char *cursor;
+    unsigned char *end;
+    int *ids;
+    char name[IDENTIFIER_LEN + 1];
+    LexemeList *list;
+
+    if ((f = fopen(filename, "rb")) == NULL) {
+        printError(ERROR_FILE_NOT_FOUND, filename);
+
+        return NULL;
+    }
+
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    if (size < LEXEME_HEADER_SIZE) {
+        fclose(f);
+        printError(ERROR_BAD_LEXEME_FILE, filename);
+
+        return NULL;
+    }
+
+    if ((stream = malloc(size)) == NULL) {
+        fclose(f);
+        printError(ERROR_OUT_OF_MEMORY);
+
+        return NULL;
+    }
+
+    if (fread(stream, 1, size, f) != (size_t) size) {
+        fclose(f);
+        free(stream);
+        printError(ERROR_BAD_LEXEME_FILE, filename);
+
+        return NULL;
+    }
+    fclose(f);
+
+    // The header must match the checksummed contents.
+    end = stream + size;
+    lexemeCount = decodeWord(stream + 8);
+    nameCount = decodeWord(stream + 12);
+    if (decodeWord(stream + 4) != LEXEME_VERSION ||
+        lexemeCount < 0 || nameCount < 0 || nameCount > lexemeCount ||
+        decodeWord(stream + 16) != checksumBytes(FNV_OFFSET_BASIS,
+                                                 stream + LEXEME_HEADER_SIZE,
+                                                 size - LEXEME_HEADER_SIZE) ||
+        (ids = malloc(sizeof(int) * (nameCount + 1))) == NULL) {
+
+        free(stream);
+        printError(ERROR_BAD_LEXEME_FILE, filename);
+
+        return NULL;
+    }
+
+    if ((list = createLexemeList()) == NULL) {
+        free(ids);
+        free(stream);
+
+        return NULL;
+    }
+
+    // Intern each name, refusing any that couldn't have been scanned.
+    cursor = stream + LEXEME_HEADER_SIZE;
+    for (i = 0; i < nameCount; i++) {
+        if (cursor >= end || *cursor == 0 || *cursor > IDENTIFIER_LEN || cursor + 1 + *cursor > end ||
+            (ids[i] = internName(list->names, (char*) cursor + 1, *cursor)) == SIGNAL_FAILURE) {
+
+            break;
+        }
+        cursor += 1 + *cursor;
+    }
+
+    if (i < nameCount) {
+        destroyLexemeList(list);
+        free(ids);
+        free(stream);
+        printError(ERROR_BAD_LEXEME_FILE, filename);
+
+        return NULL;
+    }
+
+    // Decode every record, restoring identifier names and number text.
+    for (i = 0; i < lexemeCount; i++) {
+        if (decodeVarint(&cursor, end, &token) == SIGNAL_FAILURE) {
+            break;
+        }
+
+        value = 0;
+        nameId = NO_NAME;
+        if (token == LEX_IDENTIFIER) {
+            if (decodeVarint(&cursor, end, &index) == SIGNAL_FAILURE ||
+                index < 0 || index >= nameCount) {
+
+                break;
+            }
+            nameId = ids[index];
+        }
+        else if (token == LEX_NUMBER) {
+            if (decodeVarint(&cursor, end, &value) == SIGNAL_FAILURE) {
+                break;
+            }
+            snprintf(name, sizeof(name), "%d", value);
+            if ((nameId = internName(list->names, name, strlen(name))) == SIGNAL_FAILURE) {
+                break;
+            }
+        }
+
+        if (appendLexeme(list, token, value, nameId) == SIGNAL_FAILURE) {
+            break;
+        }
+    }
+
+    free(ids);
+    free(stream);
+
+    // Every byte of the stream must belong to a record.
+    if (i < lexemeCount || cursor != end) {
+        destroyLexemeList(list);
+        printError(ERROR_BAD_LEXEME_FILE, filename);
+
+        return NULL;
+    }
+
+    return list;
+}
+
+// Free a lexeme list.
+void destroyLexemeList(LexemeList *list) {
+    if (list == NULL) {
+        return;
+    }
+
+    free(list->lexemes);
+    destroyInternTable(list->names);
+    free(list);
+}
@@ -0,0 +1,163 @@
+// Part of Plum by Tiger Sachse.
+
+#include <stdlib.h>
+#include "machine.h"
+
+// Try to match a fusable sequence starting at index. Returns the number of
+// instructions the sequence covers and fills fused, or zero if nothing matches.
+// Only current-record (L = 0) loads and stores are fused, which is all the
+// generator ever emits, so every operand fits in the R, L, and M fields.
+int matchFusion(Instruction *instructions, int index, int instructionCount, Instruction *fused) {
+    Instruction first;
+    Instruction second;
+    Instruction third;
+
+    if (index + 1 >= instructionCount) {
+        return 0;
+    }
+
+    first = instructions[index];
+    second = instructions[index + 1];
+
+    // LIT r, 0, value + STO r, 0, address.
+    if (first.opCode == LIT && second.opCode == STO &&
+        second.RField == first.RField && second.LField == 0) {
+
+        setInstruction(fused, FUSED_LIT_STO, first.RField, first.MField, second.MField);
+
+        return 2;
+    }
+
+    // Comparison r, r, m + JPC r, 0, target.
+    if (first.opCode >= EQL && first.opCode <= GEQ && first.RField == first.LField &&
+        second.opCode == JPC && second.RField == first.RField) {
+
+        setInstruction(fused,
+                       FUSED_EQL_JPC + (first.opCode - EQL),
+                       first.RField,
+                       first.MField,
+                       second.MField);
+
+        return 2;
+    }
+
+    if (index + 2 >= instructionCount) {
+        return 0;
+    }
+
+    third = instructions[index + 2];
+
+    // LOD r, 0, a + (LOD | LIT) r + 1, 0, b + (ADD | SUB) r, r, r + 1.
+    if (first.opCode == LOD && first.LField == 0 &&
+        second.RField == first.RField + 1 && second.LField == 0 &&
+        third.RField == first.RField && third.LField == first.RField &&
+        third.MField == first.RField + 1) {
+
+        if (second.opCode == LOD && third.opCode == ADD) {
+            setInstruction(fused, FUSED_LOD_LOD_ADD, first.RField, first.MField, second.MField);
+
+            return 3;
+        }
+        else if (second.opCode == LIT && third.opCode == ADD) {
+            setInstruction(fused, FUSED_LOD_LIT_ADD, first.RField, first.MField, second.MField);
+
+            return 3;
+        }
+        else if (second.opCode == LIT && third.opCode == SUB) {
+            setInstruction(fused, FUSED_LOD_LIT_SUB, first.RField, first.MField, second.MField);
+
+            return 3;
+        }
+    }
+
+    return 0;
+}
+
+// Rewrite verified instructions into a shorter program where common sequences
+// are replaced by single fused instructions. Sequences are never fused across a
+// jump target or return address, and every target is remapped to the new
+// numbering. The count of each fusion applied is added to fusions.
+Instruction *fuseInstructions(Instruction *instructions,
+                              int instructionCount,
+                              int *fusedCount,
+                              int *fusions) {
+    int i;
+    int j;
+    int length;
+    int *newIndex;
+    char *isTarget;
+    Instruction *fused;
+
+    if (instructions == NULL || fusedCount == NULL || fusions == NULL) {
+        printError(ERROR_NULL_POINTER);
+
+        return NULL;
+    }
+
+    fused = malloc(sizeof(Instruction) * instructionCount);
+    newIndex = malloc(sizeof(int) * instructionCount);
+    isTarget = calloc(instructionCount, sizeof(char));
+    if (fused == NULL || newIndex == NULL || isTarget == NULL) {
+        free(fused);
+        free(newIndex);
+        free(isTarget);
+        printError(ERROR_OUT_OF_MEMORY);
+
+        return NULL;
+    }
+
+    // Mark every place control can arrive at other than by falling through.
+    for (i = 0; i < instructionCount; i++) {
+        switch (instructions[i].opCode) {
+            case JMP:
+            case JPC:
+                isTarget[instructions[i].MField] = 1;
+                break;
+
+            case CAL:
+                isTarget[instructions[i].MField] = 1;
+                if (i + 1 < instructionCount) {
+                    isTarget[i + 1] = 1;
+                }
+                break;
+        }
+    }
+
+    // Greedily fuse from the front, refusing any match that would swallow a target.
+    *fusedCount = 0;
+    for (i = 0; i < instructionCount; i += length) {
+        newIndex[i] = *fusedCount;
+
+        length = matchFusion(instructions, i, instructionCount, &fused[*fusedCount]);
+        for (j = 1; j < length; j++) {
+            if (isTarget[i + j]) {
+                length = 0;
+                break;
+            }
+        }
+
+        if (length == 0) {
+            fused[*fusedCount] = instructions[i];
+            length = 1;
+        }
+        else {
+            fusions[fused[*fusedCount].opCode - FUSED_LIT_STO]++;
+        }
+
+        (*fusedCount)++;
+    }
+
+    // Point every jump and call at the new location of its target.
+    for (i = 0; i < *fusedCount; i++) {
+        if (fused[i].opCode == JMP || fused[i].opCode == JPC || fused[i].opCode == CAL ||
+            (fused[i].opCode >= FUSED_EQL_JPC && fused[i].opCode <= FUSED_GEQ_JPC)) {
+
+            fused[i].MField = newIndex[fused[i].MField];
+        }
+    }
+
+    free(newIndex);
+    free(isTarget);
+
+    return fused;
+}
@@ -0,0 +1,465 @@
+// Part of Plum by Tiger Sachse.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include "machine.h"
+
+// The JIT translates verified instructions straight into x86-64 machine code.
+// VM registers live in a JitContext whose address is kept in rbx, and the
+// record holding every variable is kept in r12. Only programs that never call
+// a procedure are compiled, so that record is always the main environment.
+// Anything else is handed back to the interpreter.
+
+// x86-64 register numbers used in ModRM bytes.
+enum JitRegisters {
+    JIT_EAX = 0,
+    JIT_ECX = 1,
+    JIT_EDX = 2,
+    JIT_ESI = 6,
+    JIT_EDI = 7
+};
+
+// Offsets of JIT state from rbx and r12.
+#define REGISTER_OFFSET(index) ((int) (offsetof(JitContext, registers) + sizeof(int) * (index)))
+#define LOCAL_OFFSET(index) ((int) (offsetof(RecordStackItem, locals) + sizeof(int) * (index)))
+
+// Print a value for SIO print calls made from compiled code.
+void jitPrint(int value) {
+    printf("%d\n", value);
+}
+
+// Read a value for SIO scan calls made from compiled code.
+void jitScan(int *target) {
+    scanf("%d", target);
+}
+
+// Allocate locals for INC calls made from compiled code. The frame region may
+// move, so the record is refreshed in the context. Returns zero on success.
+int jitAllocate(JitContext *context, int localCount) {
+    if (allocateLocals(context->stack, localCount) == SIGNAL_FAILURE) {
+        return 1;
+    }
+    context->record = context->stack->currentRecord;
+
+    return 0;
+}
+
+// Append a byte to the code buffer.
+void writeByte(JitBuffer *buffer, int value) {
+    buffer->code[buffer->length++] = (unsigned char) value;
+}
+
+// Append a little-endian 32 bit value to the code buffer.
+void writeInt(JitBuffer *buffer, int value) {
+    memcpy(buffer->code + buffer->length, &value, sizeof(int));
+    buffer->length += sizeof(int);
+}
+
+// Append a ModRM byte and displacement addressing [rbx + displacement].
+void writeContextOperand(JitBuffer *buffer, int reg, int displacement) {
+    writeByte(buffer, 0x83 | (reg << 3));
+    writeInt(buffer, displacement);
+}
+
+// Append a ModRM byte, SIB byte, and displacement addressing [r12 + displacement].
+// The caller has already written a REX prefix with the B bit set.
+void writeRecordOperand(JitBuffer *buffer, int reg, int displacement) {
+    writeByte(buffer, 0x84 | (reg << 3));
+    writeByte(buffer, 0x24);
+    writeInt(buffer, displacement);
+}
+
+// Load VM register index into an x86 register.
+void writeLoadRegister(JitBuffer *buffer, int reg, int index) {
+    writeByte(buffer, 0x8B);
+    writeContextOperand(buffer, reg, REGISTER_OFFSET(index));
+}
+
+// Store an x86 register into VM register index.
+void writeStoreRegister(JitBuffer *buffer, int reg, int index) {
+    writeByte(buffer, 0x89);
+    writeContextOperand(buffer, reg, REGISTER_OFFSET(index));
+}
+
+// Call a C function at address. The stack is kept 16 byte aligned by the prologue.
+void writeCall(JitBuffer *buffer, void *address) {
+    writeByte(buffer, 0x48);
+    writeByte(buffer, 0xB8);
+    memcpy(buffer->code + buffer->length, &address, sizeof(void*));
+    buffer->length += sizeof(void*);
+    writeByte(buffer, 0xFF);
+    writeByte(buffer, 0xD0);
+}
+
+// Leave compiled code with an exit code and a value for its error message.
+void writeExit(JitBuffer *buffer, int exitCode, int errorValue) {
+    writeByte(buffer, 0xC7);
+    writeContextOperand(buffer, 0, (int) offsetof(JitContext, errorValue));
+    writeInt(buffer, errorValue);
+    writeByte(buffer, 0xB8 | JIT_EAX);
+    writeInt(buffer, exitCode);
+    writeByte(buffer, 0xE9);
+    writeInt(buffer, buffer->epilogue - (buffer->length + 4));
+}
+
+// Leave compiled code unless the variable at index exists in the record in r12.
+void writeLocalCheck(JitBuffer *buffer, int index) {
+    int skip;
+
+    // cmp dword [r12 + localCount], index; jg past the exit.
+    writeByte(buffer, 0x41);
+    writeByte(buffer, 0x81);
+    writeRecordOperand(buffer, 7, (int) offsetof(RecordStackItem, localCount));
+    writeInt(buffer, index);
+    writeByte(buffer, 0x7F);
+    skip = buffer->length;
+    writeByte(buffer, 0);
+
+    writeExit(buffer, JIT_EXIT_LOCAL_INDEX, index);
+    buffer->code[skip] = (unsigned char) (buffer->length - (skip + 1));
+}
+
+// Emit machine code for a single instruction. Returns SIGNAL_FAILURE if the
+// instruction can't be compiled. Jumps are left for compileInstructions to patch.
+int compileInstruction(JitBuffer *buffer, Instruction instruction) {
+    int index;
+    int skip;
+
+    // Condition codes for the comparison operations, in opcode order from EQL.
+    static int conditionCodes[] = {
+        0x4,    // EQL: equal.
+        0x5,    // NEQ: not equal.
+        0xC,    // LSS: less.
+        0xE,    // LEQ: less or equal.
+        0xF,    // GTR: greater.
+        0xD     // GEQ: greater or equal.
+    };
+
+    switch (instruction.opCode) {
+        case LIT:
+            writeByte(buffer, 0xC7);
+            writeContextOperand(buffer, 0, REGISTER_OFFSET(instruction.RField));
+            writeInt(buffer, instruction.MField);
+            break;
+
+        // Every L field names the main environment, since nothing is ever called.
+        case LOD:
+        case STO:
+            if (instruction.MField == 0) {
+                index = (int) offsetof(RecordStackItem, returnValue);
+            }
+            else if ((index = instruction.MField - INT_OFFSET) < 0) {
+                writeExit(buffer, JIT_EXIT_LOCAL_INDEX, index);
+                break;
+            }
+            else {
+                writeLocalCheck(buffer, index);
+                index = LOCAL_OFFSET(index);
+            }
+
+            if (instruction.opCode == LOD) {
+                writeByte(buffer, 0x41);
+                writeByte(buffer, 0x8B);
+                writeRecordOperand(buffer, JIT_EAX, index);
+                writeStoreRegister(buffer, JIT_EAX, instruction.RField);
+            }
+            else {
+                writeLoadRegister(buffer, JIT_EAX, instruction.RField);
+                writeByte(buffer, 0x41);
+                writeByte(buffer, 0x89);
+                writeRecordOperand(buffer, JIT_EAX, index);
+            }
+            break;
+
+        // mov rdi, rbx; mov esi, count; call jitAllocate; then reload r12.
+        case INC:
+            writeByte(buffer, 0x48);
+            writeByte(buffer, 0x89);
+            writeByte(buffer, 0xDF);
+            writeByte(buffer, 0xB8 | JIT_ESI);
+            writeInt(buffer, instruction.MField - INT_OFFSET);
+            writeCall(buffer, (void*) jitAllocate);
+
+            writeByte(buffer, 0x85);
+            writeByte(buffer, 0xC0);
+            writeByte(buffer, 0x74);
+            skip = buffer->length;
+            writeByte(buffer, 0);
+            writeExit(buffer, JIT_EXIT_FAILURE, 0);
+            buffer->code[skip] = (unsigned char) (buffer->length - (skip + 1));
+
+            writeByte(buffer, 0x4C);
+            writeByte(buffer, 0x8B);
+            writeContextOperand(buffer, 4, (int) offsetof(JitContext, record));
+            break;
+
+        // Unconditional jumps are a bare jmp rel32.
+        case JMP:
+            writeByte(buffer, 0xE9);
+            writeInt(buffer, 0);
+            break;
+
+        // cmp dword [register], 0; je rel32.
+        case JPC:
+            writeByte(buffer, 0x83);
+            writeContextOperand(buffer, 7, REGISTER_OFFSET(instruction.RField));
+            writeByte(buffer, 0);
+            writeByte(buffer, 0x0F);
+            writeByte(buffer, 0x84);
+            writeInt(buffer, 0);
+            break;
+
+        case SIO:
+            if (instruction.MField == CALL_PRINT) {
+                writeByte(buffer, 0x8B);
+                writeContextOperand(buffer, JIT_EDI, REGISTER_OFFSET(instruction.RField));
+                writeCall(buffer, (void*) jitPrint);
+            }
+            else if (instruction.MField == CALL_SCAN) {
+                writeByte(buffer, 0x48);
+                writeByte(buffer, 0x8D);
+                writeContextOperand(buffer, JIT_EDI, REGISTER_OFFSET(instruction.RField));
+                writeCall(buffer, (void*) jitScan);
+            }
+            else {
+                writeExit(buffer, JIT_EXIT_KILL, 0);
+            }
+            break;
+
+        case NEG:
+            writeLoadRegister(buffer, JIT_EAX, instruction.LField);
+            writeByte(buffer, 0xF7);
+            writeByte(buffer, 0xD8);
+            writeStoreRegister(buffer, JIT_EAX, instruction.RField);
+            break;
+
+        case ADD:
+        case SUB:
+        case MUL:
+            writeLoadRegister(buffer, JIT_EAX, instruction.LField);
+            if (instruction.opCode == ADD) {
+                writeByte(buffer, 0x03);
+            }
+            else if (instruction.opCode == SUB) {
+                writeByte(buffer, 0x2B);
+            }
+            else {
+                writeByte(buffer, 0x0F);
+                writeByte(buffer, 0xAF);
+            }
+            writeContextOperand(buffer, JIT_EAX, REGISTER_OFFSET(instruction.MField));
+            writeStoreRegister(buffer, JIT_EAX, instruction.RField);
+            break;
+
+        // Division checks for zero like the interpreter does. Modulus doesn't.
+        case DIV:
+        case MOD:
+            writeLoadRegister(buffer, JIT_EAX, instruction.LField);
+            writeLoadRegister(buffer, JIT_ECX, instruction.MField);
+            if (instruction.opCode == DIV) {
+                writeByte(buffer, 0x85);
+                writeByte(buffer, 0xC9);
+                writeByte(buffer, 0x75);
+                skip = buffer->length;
+                writeByte(buffer, 0);
+                writeExit(buffer, JIT_EXIT_DIVIDE_BY_ZERO, 0);
+                buffer->code[skip] = (unsigned char) (buffer->length - (skip + 1));
+            }
+            writeByte(buffer, 0x99);
+            writeByte(buffer, 0xF7);
+            writeByte(buffer, 0xF9);
+            writeStoreRegister(buffer, (instruction.opCode == DIV) ? JIT_EAX : JIT_EDX,
+                               instruction.RField);
+            break;
+
+        // The low bit of a two's complement int is set exactly when it's odd.
+        case ODD:
+            writeLoadRegister(buffer, JIT_EAX, instruction.RField);
+            writeByte(buffer, 0x83);
+            writeByte(buffer, 0xE0);
+            writeByte(buffer, 0x01);
+            writeStoreRegister(buffer, JIT_EAX, instruction.RField);
+            break;
+
+        // cmp eax, [M]; setcc al; movzx eax, al.
+        case EQL: case NEQ:
+        case LSS: case LEQ:
+        case GTR: case GEQ:
+            writeLoadRegister(buffer, JIT_EAX, instruction.LField);
+            writeByte(buffer, 0x3B);
+            writeContextOperand(buffer, JIT_EAX, REGISTER_OFFSET(instruction.MField));
+            writeByte(buffer, 0x0F);
+            writeByte(buffer, 0x90 | conditionCodes[instruction.opCode - EQL]);
+            writeByte(buffer, 0xC0);
+            writeByte(buffer, 0x0F);
+            writeByte(buffer, 0xB6);
+            writeByte(buffer, 0xC0);
+            writeStoreRegister(buffer, JIT_EAX, instruction.RField);
+            break;
+
+        // Procedures need real activation records, which only the interpreter has.
+        default:
+            return SIGNAL_FAILURE;
+    }
+
+    return SIGNAL_SUCCESS;
+}
+
+// Translate verified instructions into executable machine code. Returns NULL
+// if any instruction can't be compiled, so the caller can fall back.
+JitFunction compileInstructions(Instruction *instructions, int instructionCount, JitBuffer *buffer) {
+    int i;
+    int *offsets;
+    int displacement;
+
+    // Check the whole program first so nothing is mapped for programs that
+    // will be interpreted anyway. Code and locals must be addressable with 32 bits.
+    if (instructionCount > JIT_MAX_INSTRUCTIONS) {
+        return NULL;
+    }
+    for (i = 0; i < instructionCount; i++) {
+        if (instructions[i].opCode == CAL || instructions[i].opCode == RTN ||
+            ((instructions[i].opCode == LOD || instructions[i].opCode == STO) &&
+             instructions[i].MField > JIT_MAX_ADDRESS)) {
+
+            return NULL;
+        }
+    }
+
+    buffer->capacity = JIT_PROLOGUE_SIZE + (size_t) instructionCount * JIT_INSTRUCTION_SIZE;
+    buffer->code = mmap(NULL, buffer->capacity, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffer->code == MAP_FAILED) {
+        buffer->code = NULL;
+
+        return NULL;
+    }
+
+    if ((offsets = malloc(sizeof(int) * (instructionCount + 1))) == NULL) {
+        destroyJitBuffer(buffer);
+
+        return NULL;
+    }
+
+    // The epilogue comes first so that every exit jumps backwards to a known place.
+    // pop r13; pop r12; pop rbx; ret.
+    buffer->length = 0;
+    buffer->epilogue = 0;
+    writeByte(buffer, 0x41);
+    writeByte(buffer, 0x5D);
+    writeByte(buffer, 0x41);
+    writeByte(buffer, 0x5C);
+    writeByte(buffer, 0x5B);
+    writeByte(buffer, 0xC3);
+
+    // push rbx; push r12; push r13; mov rbx, rdi; mov r12, [rbx + record].
+    buffer->entry = buffer->length;
+    writeByte(buffer, 0x53);
+    writeByte(buffer, 0x41);
+    writeByte(buffer, 0x54);
+    writeByte(buffer, 0x41);
+    writeByte(buffer, 0x55);
+    writeByte(buffer, 0x48);
+    writeByte(buffer, 0x89);
+    writeByte(buffer, 0xFB);
+    writeByte(buffer, 0x4C);
+    writeByte(buffer, 0x8B);
+    writeContextOperand(buffer, 4, (int) offsetof(JitContext, record));
+
+    for (i = 0; i < instructionCount; i++) {
+        offsets[i] = buffer->length;
+        compileInstruction(buffer, instructions[i]);
+    }
+    offsets[instructionCount] = buffer->length;
+
+    // Every jump ends in its rel32, which is relative to the next instruction.
+    // Patch them now that every target has been placed.
+    for (i = 0; i < instructionCount; i++) {
+        if (instructions[i].opCode == JMP || instructions[i].opCode == JPC) {
+            displacement = offsets[instructions[i].MField] - offsets[i + 1];
+            memcpy(buffer->code + offsets[i + 1] - sizeof(int), &displacement, sizeof(int));
+        }
+    }
+
+    free(offsets);
+
+    if (mprotect(buffer->code, buffer->capacity, PROT_READ | PROT_EXEC) != 0) {
+        destroyJitBuffer(buffer);
+
+        return NULL;
+    }
+
+    return (JitFunction) (buffer->code + buffer->entry);
+}
+
+// Run the provided instructions as native code. Returns SIGNAL_RECOVERY without
+// running anything if the program can't be compiled, so it can be interpreted.
+int processCompiledInstructions(Instruction *instructions, int instructionCount) {
+    int exitCode;
+    JitBuffer buffer;
+    JitContext context;
+    JitFunction function;
+
+    if (instructions == NULL || instructionCount == 0) {
+        printError(ERROR_NULL_POINTER);
+
+        return SIGNAL_FAILURE;
+    }
+
+#if !defined(__x86_64__)
+    return SIGNAL_RECOVERY;
+#endif
+
+    memset(&buffer, 0, sizeof(JitBuffer));
+    if ((function = compileInstructions(instructions, instructionCount, &buffer)) == NULL) {
+        return SIGNAL_RECOVERY;
+    }
+
+    memset(&context, 0, sizeof(JitContext));
+    if ((context.stack = initializeRecordStack()) == NULL) {
+        destroyJitBuffer(&buffer);
+        printError(ERROR_OUT_OF_MEMORY);
+
+        return SIGNAL_FAILURE;
+    }
+
+    // The main environment is the only record compiled code ever uses.
+    context.cpu = createCPU(instructionCount);
+    if (context.cpu == NULL || pushRecord(context.cpu, context.stack) == SIGNAL_FAILURE) {
+        destroyCPU(context.cpu);
+        destroyRecordStack(context.stack);
+        destroyJitBuffer(&buffer);
+        printError(ERROR_OUT_OF_MEMORY);
+
+        return SIGNAL_FAILURE;
+    }
+    context.record = context.stack->currentRecord;
+
+    exitCode = function(&context);
+
+    // Report errors exactly as the interpreter would have.
+    if (exitCode == JIT_EXIT_DIVIDE_BY_ZERO) {
+        printError(ERROR_DIVIDE_BY_ZERO);
+    }
+    else if (exitCode == JIT_EXIT_LOCAL_INDEX) {
+        printError(ERROR_LOCAL_INDEX_OUT_OF_BOUNDS, context.errorValue);
+    }
+
+    // Stay memory safe!
+    destroyCPU(context.cpu);
+    destroyRecordStack(context.stack);
+    destroyJitBuffer(&buffer);
+
+    return (exitCode == JIT_EXIT_KILL) ? SIGNAL_SUCCESS : SIGNAL_FAILURE;
+}
+
+// Unmap the machine code in a JIT buffer.
+void destroyJitBuffer(JitBuffer *buffer) {
+    if (buffer != NULL && buffer->code != NULL) {
+        munmap(buffer->code, buffer->capacity);
+        buffer->code = NULL;
+    }
+}
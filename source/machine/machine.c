@@ -2,12 +2,18 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "machine.h"
 
 // Start the machine.
 int startMachine(char *inFile, int options) {
+    int processReturn;
     int instructionCount;
     Instruction *instructions;
+    MappedBytecode mapping = { NULL, 0 };
 
     if (inFile == NULL) {
         printError(ERROR_NULL_POINTER);
@@ -15,28 +21,113 @@ int startMachine(char *inFile, int options) {
         return SIGNAL_FAILURE;
     }
 
-    // If the instructions could not be counted, return SIGNAL_FAILURE.
-    if ((instructionCount = countInstructions(inFile)) == SIGNAL_FAILURE) {
+    // If the instructions could not be read or verified, return SIGNAL_FAILURE.
+    if ((instructions = readInstructions(inFile, &instructionCount, &mapping)) == NULL) {
         return SIGNAL_FAILURE;
     }
-    
-    // If the instructions could not be loaded, return SIGNAL_FAILURE.
-    if ((instructions = loadInstructions(inFile, instructionCount)) == NULL) {
+
+    processReturn = runProgram(instructions, instructionCount, options);
+    releaseInstructions(instructions, &mapping);
+
+    return processReturn;
+}
+
+// Start the machine on instructions that are already in memory, such as those
+// straight from the generator. The instructions still belong to the caller.
+int startMachineWithInstructions(Instruction *instructions, int instructionCount, int options) {
+    if (instructions == NULL) {
+        printError(ERROR_NULL_POINTER);
+
         return SIGNAL_FAILURE;
     }
-    
-    // If something goes wrong while processing the instructions, return SIGNAL_FAILURE.
-    if ((processInstructions(instructions, instructionCount, options)) == SIGNAL_FAILURE) {
-        destroyInstructions(instructions);
 
+    // Reject the program before it starts if it can't be proven safe to run
+    // without per-instruction checks.
+    if (verifyInstructions(instructions, instructionCount) == SIGNAL_FAILURE) {
         return SIGNAL_FAILURE;
     }
-    // Else everything worked!
+
+    return runProgram(instructions, instructionCount, options);
+}
+
+// Run verified instructions with the engine selected in the options. The
+// instructions are left untouched.
+int runProgram(Instruction *instructions, int instructionCount, int options) {
+    int tracing;
+    int processReturn;
+    Instruction *fusedInstructions;
+    int fusions[FUSION_PATTERNS] = { 0 };
+
+    tracing = (getTraceMode(options) != TRACE_NONE);
+
+    // Run the program as native code if asked. Programs the JIT can't compile
+    // fall through to the interpreter below.
+    if (checkOption(&options, OPTION_JIT) && !tracing) {
+        processReturn = processCompiledInstructions(instructions, instructionCount);
+
+        if (processReturn != SIGNAL_RECOVERY) {
+            return (processReturn == SIGNAL_FAILURE) ? SIGNAL_FAILURE : SIGNAL_SUCCESS;
+        }
+    }
+
+    // Traced runs use the original fetch/execute loop on the instructions as
+    // they are, so that the trace matches the bytecode instruction for
+    // instruction. The threaded engine has no tracing support either.
+    if (tracing) {
+        processReturn = processInstructions(instructions, instructionCount, options);
+
+        return (processReturn == SIGNAL_FAILURE) ? SIGNAL_FAILURE : SIGNAL_SUCCESS;
+    }
+
+    // Fuse common instruction sequences into single instructions.
+    fusedInstructions = fuseInstructions(instructions, instructionCount,
+                                         &instructionCount, fusions);
+    if (fusedInstructions == NULL) {
+        return SIGNAL_FAILURE;
+    }
+
+    if (checkOption(&options, OPTION_PRINT_FUSIONS)) {
+        printFusionReport(fusions);
+    }
+
+    if (checkOption(&options, OPTION_THREADED_DISPATCH)) {
+        processReturn = processThreadedInstructions(fusedInstructions, instructionCount);
+    }
     else {
-        destroyInstructions(instructions);
+        processReturn = processInstructions(fusedInstructions, instructionCount, options);
+    }
+
+    free(fusedInstructions);
+
+    return (processReturn == SIGNAL_FAILURE) ? SIGNAL_FAILURE : SIGNAL_SUCCESS;
+}
+
+// Read the bytecode file at filename, in either format, and verify it. Binary
+// bytecode is left in the mapping, which releaseInstructions() cleans up.
+Instruction *readInstructions(char *filename, int *instructionCount, MappedBytecode *mapping) {
+    Instruction *instructions;
+
+    // Binary bytecode is mapped and run in place, without any parsing.
+    if (isBytecodeFile(filename)) {
+        if ((instructions = mapInstructions(filename, instructionCount, mapping)) == NULL) {
+            return NULL;
+        }
+    }
+
+    // Else the text bytecode is parsed in a single pass.
+    else if ((instructions = loadInstructions(filename, instructionCount)) == NULL) {
+        return NULL;
+    }
 
-        return SIGNAL_SUCCESS;
+    // Reject the program before it starts if it can't be proven safe to run
+    // without per-instruction checks.
+    if (verifyInstructions(instructions, *instructionCount) == SIGNAL_FAILURE) {
+        releaseInstructions(instructions, mapping);
+
+        return NULL;
     }
+
+    return instructions;
 }
 
 // Create a CPU for the machine.
@@ -58,94 +149,222 @@ int destroyCPU(CPU *cpu) {
     return SIGNAL_SUCCESS; 
 }
 
-// Count instructions in provided file. Needed for programCounter bounds checks.
-int countInstructions(char *filename) {
+// Load text bytecode from filename in a single pass. The file is read in
+// blocks and parsed by hand into an instruction array that grows as needed, so
+// there is no limit on program length. The count is stored in instructionCount.
+Instruction *loadInstructions(char *filename, int *instructionCount) {
     FILE *f;
+    int i;
+    int done;
     int count;
-    char buffer;
+    int field;
+    int digits;
+    int negative;
+    int capacity;
+    int length;
+    int *fields;
+    long long value;
+    char character;
+    char buffer[LOAD_BUFFER_SIZE];
+    Instruction *instructions;
+    Instruction *grown;
 
-    if (filename == NULL) {
+    if (filename == NULL || instructionCount == NULL) {
         printError(ERROR_NULL_POINTER);
         
-        return SIGNAL_FAILURE;
+        return NULL;
     }
 
-    // If the file can't be opened, return SIGNAL_FAILURE.
+    // If the file can't be opened, return NULL.
     if ((f = fopen(filename, "r")) == NULL) {
-        return SIGNAL_FAILURE;
+        printError(ERROR_FILE_NOT_FOUND, filename);
+        
+        return NULL;
+    }
+
+    capacity = INITIAL_INSTRUCTION_CAPACITY;
+    if ((instructions = malloc(sizeof(Instruction) * capacity)) == NULL) {
+        fclose(f);
+        printError(ERROR_OUT_OF_MEMORY);
+
+        return NULL;
     }
 
-    // Count the number of lines in the file.
     count = 0;
-    while (fscanf(f, "%c", &buffer) != EOF) {
-        if (buffer == '\n') {
-            if (count < MAX_LINES) {
-                count++;
-            }
+    field = 0;
+    value = 0;
+    digits = 0;
+    negative = 0;
+    done = 0;
+    while (!done) {
+
+        // At the end of the file, parse one final newline so that the last
+        // number is stored like any other.
+        if ((length = fread(buffer, 1, LOAD_BUFFER_SIZE, f)) == 0) {
+            buffer[0] = '\n';
+            length = 1;
+            done = 1;
+        }
+
+        for (i = 0; i < length; i++) {
+            character = buffer[i];
 
-            // If the maximum number of lines has been reached, close the
-            // file and return SIGNAL_FAILURE.
-            else {
-                fclose(f);
-                printError(ERROR_FILE_TOO_LONG, filename);
+            // Accumulate digits, refusing anything that won't fit in an int.
+            if (isDigit(character)) {
+                value = value * 10 + (character - '0');
+                digits++;
+                if (value > (long long) INT_MAX + negative) {
+                    break;
+                }
+            }
+            else if (character == '-' && digits == 0 && !negative) {
+                negative = 1;
+            }
+            else if (!isWhitespace(character) && character != '\r') {
+                break;
+            }
 
-                return SIGNAL_FAILURE;
+            // Whitespace ends a number. A lone minus sign is not a number.
+            else if (digits > 0) {
+                if (count == capacity) {
+                    if (capacity > INT_MAX / 2 ||
+                        (grown = realloc(instructions,
+                                         sizeof(Instruction) * capacity * 2)) == NULL) {
+
+                        fclose(f);
+                        free(instructions);
+                        printError(ERROR_OUT_OF_MEMORY);
+
+                        return NULL;
+                    }
+                    instructions = grown;
+                    capacity *= 2;
+                }
+
+                fields = (int*) &instructions[count];
+                fields[field] = (int) ((negative) ? -value : value);
+                if (++field == 4) {
+                    field = 0;
+                    count++;
+                }
+
+                value = 0;
+                digits = 0;
+                negative = 0;
+            }
+            else if (negative) {
+                break;
             }
         }
+
+        // Parsing stopped early on something that isn't part of a number.
+        if (i < length) {
+            fclose(f);
+            free(instructions);
+            printError(ERROR_BAD_BYTECODE_FILE, filename);
+
+            return NULL;
+        }
     }
-    
+
     fclose(f);
 
-    return count;
+    // Every instruction needs all four of its fields.
+    if (field != 0 || count == 0) {
+        free(instructions);
+        printError(ERROR_UNEXPECTED_END_OF_FILE);
+
+        return NULL;
+    }
+
+    *instructionCount = count;
+
+    return instructions;
 }
 
-// Load compiled instructions from a file at filename.
-Instruction *loadInstructions(char *filename, int instructionCount) {
-    int i;
-    FILE *f;
+// Map the binary bytecode file at filename into memory and return its
+// instructions, which are used in place. The header and checksum are checked
+// before anything is returned.
+Instruction *mapInstructions(char *filename, int *instructionCount, MappedBytecode *mapping) {
+    int descriptor;
+    struct stat status;
+    BytecodeHeader *header;
     Instruction *instructions;
 
-    if (filename == NULL) {
+    if (filename == NULL || instructionCount == NULL || mapping == NULL) {
         printError(ERROR_NULL_POINTER);
-        
+
         return NULL;
     }
 
-    // If the file can't be opened, return NULL.
-    if ((f = fopen(filename, "r")) == NULL) {
+    if ((descriptor = open(filename, O_RDONLY)) < 0) {
         printError(ERROR_FILE_NOT_FOUND, filename);
-        
+
         return NULL;
     }
 
-    // Create an array of instructions of length instructionCount. If the allocation fails,
-    // close the file and return NULL.
-    if ((instructions = malloc(sizeof(Instruction) * instructionCount)) == NULL) {
-        fclose(f);
+    // The header can't be read at all unless the file is at least that long.
+    if (fstat(descriptor, &status) != 0 || status.st_size < (off_t) sizeof(BytecodeHeader)) {
+        close(descriptor);
+        printError(ERROR_BAD_BYTECODE_FILE, filename);
+
+        return NULL;
+    }
+
+    // The mapping stays valid after the descriptor is closed.
+    header = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    close(descriptor);
+    if (header == MAP_FAILED) {
         printError(ERROR_OUT_OF_MEMORY);
 
         return NULL;
     }
 
-    // For each line in the file, set the appropriate values for the corresponding
-    // location in the new instructions array.
-    for (i = 0; i < instructionCount; i++) {
-        fscanf(f, "%d %d %d %d\n", &instructions[i].opCode,
-                                   &instructions[i].RField,
-                                   &instructions[i].LField,
-                                   &instructions[i].MField);
+    instructions = (Instruction*) (header + 1);
+
+    if (checkBytecodeHeader(header, (long) status.st_size, filename) == SIGNAL_FAILURE) {
+        munmap(header, status.st_size);
+
+        return NULL;
     }
 
-    fclose(f);
+    if (checksumInstructions(FNV_OFFSET_BASIS, instructions, header->instructionCount) !=
+        header->checksum) {
+
+        munmap(header, status.st_size);
+        printError(ERROR_BAD_BYTECODE_FILE, filename);
+
+        return NULL;
+    }
+
+    mapping->region = header;
+    mapping->length = status.st_size;
+    *instructionCount = header->instructionCount;
 
     return instructions;
 }
 
-// Process the provided instructions using a CPU.
+// Decide once how much of each step to trace, based on the options.
+int getTraceMode(int options) {
+    if (checkOption(&options, OPTION_TRACE_RECORDS) ||
+        checkOption(&options, OPTION_TRACE_REGISTERS)) {
+
+        return TRACE_FULL;
+    }
+    else if (checkOption(&options, OPTION_TRACE_CPU)) {
+        return TRACE_CPU;
+    }
+    else {
+        return TRACE_NONE;
+    }
+}
+
+// Process the provided instructions using a CPU. The loop that runs them is
+// chosen here, once, so the untraced loop carries no trace logic at all.
 int processInstructions(Instruction *instructions, int instructionCount, int options) {
-    int i;
+    int traceMode;
+    int returnValue;
     CPU *cpu;
-    int executeReturn;
     RecordStack *stack;
 
     if (instructions == NULL || instructionCount == 0) {
@@ -172,78 +391,89 @@ int processInstructions(Instruction *instructions, int instructionCount, int opt
     // Push an initial record onto the stack for the main environment.
     pushRecord(cpu, stack);
   
-    if (checkOption(&options, OPTION_TRACE_CPU) ||
-        checkOption(&options, OPTION_TRACE_RECORDS) ||
-        checkOption(&options, OPTION_TRACE_REGISTERS)) {
-    
+    traceMode = getTraceMode(options);
+    if (traceMode != TRACE_NONE) {
         printStackTraceHeader(options);
     }
 
-    // Perform successive fetches and executes for the array of instructions
-    // until an error occurs or a SIGNAL_KILL system call is made.
-    executeReturn = SIGNAL_SUCCESS;
-    while (executeReturn != SIGNAL_KILL) {
-        
-        // Check that fetchInstruction is successful.
-        if (fetchInstruction(cpu, instructions) == SIGNAL_FAILURE) {
-            destroyCPU(cpu);
-            
-            return SIGNAL_FAILURE;
-        }
+    switch (traceMode) {
+        case TRACE_NONE:
+            returnValue = runInstructions(cpu, stack, instructions);
+            break;
 
-        // Check that executeInstruction is successful.
-        if ((executeReturn = executeInstruction(cpu, stack)) == SIGNAL_FAILURE) {
-            destroyCPU(cpu);
-            
-            return SIGNAL_FAILURE;
-        }
+        case TRACE_CPU:
+            returnValue = runCPUTracedInstructions(cpu, stack, instructions);
+            break;
 
-        if (checkOption(&options, OPTION_TRACE_CPU) ||
-            checkOption(&options, OPTION_TRACE_RECORDS) ||
-            checkOption(&options, OPTION_TRACE_REGISTERS)) {
-        
-            printStackTraceLine(cpu, stack, options);
-        }
+        default:
+            returnValue = runTracedInstructions(cpu, stack, instructions, options);
     }
 
     // Stay memory safe!
     destroyCPU(cpu);
     destroyRecordStack(stack);
 
+    return returnValue;
+}
+
+// Perform successive fetches and executes for the array of instructions until
+// an error occurs or a SIGNAL_KILL system call is made.
+int runInstructions(CPU *cpu, RecordStack *stack, Instruction *instructions) {
+    int executeReturn;
+
+    do {
+        fetchInstruction(cpu, instructions);
+        executeReturn = executeInstruction(cpu, stack);
+    } while (executeReturn != SIGNAL_KILL && executeReturn != SIGNAL_FAILURE);
+
+    return (executeReturn == SIGNAL_FAILURE) ? SIGNAL_FAILURE : SIGNAL_SUCCESS;
+}
+
+// The same as runInstructions(), but print the CPU after every step.
+int runCPUTracedInstructions(CPU *cpu, RecordStack *stack, Instruction *instructions) {
+    int executeReturn;
+
+    do {
+        fetchInstruction(cpu, instructions);
+        if ((executeReturn = executeInstruction(cpu, stack)) == SIGNAL_FAILURE) {
+            return SIGNAL_FAILURE;
+        }
+
+        printCPU(cpu);
+        printf("\n");
+    } while (executeReturn != SIGNAL_KILL);
+
     return SIGNAL_SUCCESS;
 }
 
-// Fetch next instruction from instructions and place in the CPU instRegister.
-int fetchInstruction(CPU *cpu, Instruction *instructions) {
-    if (cpu == NULL || instructions == NULL) {
-        printError(ERROR_NULL_POINTER);
-        
-        return SIGNAL_FAILURE;
-    }
+// The same as runInstructions(), but print everything the options ask for
+// after every step.
+int runTracedInstructions(CPU *cpu, RecordStack *stack, Instruction *instructions, int options) {
+    int executeReturn;
 
-    // If the desired instruction (indicated by cpu->programCounter) is not out of
-    // bounds, increment the programCounter and load the new instruction into the
-    // instRegister.
-    if (cpu->programCounter >= 0 && cpu->programCounter < cpu->instructionCount) {
-        cpu->instRegister = instructions[cpu->programCounter];
-        cpu->programCounter++;
+    do {
+        fetchInstruction(cpu, instructions);
+        if ((executeReturn = executeInstruction(cpu, stack)) == SIGNAL_FAILURE) {
+            return SIGNAL_FAILURE;
+        }
 
-        return SIGNAL_SUCCESS;
-    }
-    else {
-        printError(ERROR_PROGRAM_COUNTER_OUT_OF_BOUNDS, cpu->programCounter);
+        printStackTraceLine(cpu, stack, options);
+    } while (executeReturn != SIGNAL_KILL);
 
-        return SIGNAL_FAILURE;
-    }
+    return SIGNAL_SUCCESS;
+}
+
+// Fetch next instruction from instructions and place in the CPU instRegister.
+// The verifier guarantees that the programCounter is always in bounds.
+int fetchInstruction(CPU *cpu, Instruction *instructions) {
+    cpu->instRegister = instructions[cpu->programCounter];
+    cpu->programCounter++;
+
+    return SIGNAL_SUCCESS;
 }
 
 // Execute instruction loaded into CPU.
 int executeInstruction(CPU *cpu, RecordStack *stack) {
-    if (cpu == NULL || stack == NULL || stack->currentRecord == NULL) {
-        printError(ERROR_NULL_POINTER);
-        
-        return SIGNAL_FAILURE;
-    }
 
     // Execute the corresponding function for the instruction
     // loaded into the instRegister.
@@ -270,6 +500,17 @@ int executeInstruction(CPU *cpu, RecordStack *stack) {
         case LEQ: return operationIsLessThanOrEqualTo(cpu);
         case GTR: return operationIsGreaterThan(cpu);
         case GEQ: return operationIsGreaterThanOrEqualTo(cpu);
+
+        case FUSED_LIT_STO: return operationFusedLiteralStore(cpu, stack);
+        case FUSED_LOD_LOD_ADD: return operationFusedLoadLoadAdd(cpu, stack);
+        case FUSED_LOD_LIT_ADD:
+        case FUSED_LOD_LIT_SUB: return operationFusedLoadLiteralArithmetic(cpu, stack);
+        case FUSED_EQL_JPC:
+        case FUSED_NEQ_JPC:
+        case FUSED_LSS_JPC:
+        case FUSED_LEQ_JPC:
+        case FUSED_GTR_JPC:
+        case FUSED_GEQ_JPC: return operationFusedCompareJump(cpu);
         
         default:
             printError(ERROR_ILLEGAL_OP_CODE, cpu->instRegister.opCode);
@@ -284,3 +525,16 @@ int destroyInstructions(Instruction *instructions) {
 
     return SIGNAL_SUCCESS;
 }
+
+// Free an instruction array, or unmap it if it came from a binary bytecode file.
+int releaseInstructions(Instruction *instructions, MappedBytecode *mapping) {
+    if (mapping == NULL || mapping->region == NULL) {
+        return destroyInstructions(instructions);
+    }
+
+    munmap(mapping->region, mapping->length);
+    mapping->region = NULL;
+    mapping->length = 0;
+
+    return SIGNAL_SUCCESS;
+}
@@ -3,10 +3,40 @@
 #ifndef MACHINE_H
 #define MACHINE_H
 
+#include <stdio.h>
+#include <stddef.h>
 #include "../plum.h"
 
 // Constants.
-#define MAX_LINES 1000
+#define NO_RECORD -1
+#define LOAD_BUFFER_SIZE 65536
+#define INITIAL_INSTRUCTION_CAPACITY 1024
+#define INITIAL_FRAME_CAPACITY 1024
+#define INITIAL_DISPLAY_CAPACITY 16
+#define MAX_FRAME_SIZE (1 << 24)
+#define JIT_PROLOGUE_SIZE 32
+#define JIT_INSTRUCTION_SIZE 64
+#define JIT_MAX_INSTRUCTIONS ((INT_MAX - JIT_PROLOGUE_SIZE) / JIT_INSTRUCTION_SIZE)
+#define JIT_MAX_ADDRESS (INT_MAX / 8)
+#define RECORD_HEADER_SIZE ((int) (sizeof(RecordStackItem) / sizeof(int)))
+
+// Internal opcodes for fused instruction sequences. These never appear in
+// bytecode files; they are only produced by fuseInstructions().
+enum FusedOpcodes {
+    FUSED_LIT_STO = GEQ + 1,
+    FUSED_LOD_LOD_ADD,
+    FUSED_LOD_LIT_ADD,
+    FUSED_LOD_LIT_SUB,
+    FUSED_EQL_JPC,
+    FUSED_NEQ_JPC,
+    FUSED_LSS_JPC,
+    FUSED_LEQ_JPC,
+    FUSED_GTR_JPC,
+    FUSED_GEQ_JPC
+};
+
+// Number of distinct fused opcodes.
+#define FUSION_PATTERNS (FUSED_GEQ_JPC - FUSED_LIT_STO + 1)
 
 // CPU struct to hold registers and the current instruction.
 typedef struct CPU {
@@ -16,40 +46,112 @@ typedef struct CPU {
     Instruction instRegister;
 } CPU;
 
-// An item in an activation record stack. Also serves as a node in
-// a linked list (that's how the stack is implemented).
+// The header of an activation record. Records are stored back to back in one
+// int region, each followed directly by its locals, and link to each other by
+// their offset into that region. Static parents are found through the display,
+// so each record only remembers its lexical depth and the display entry it
+// replaced at that depth.
 typedef struct RecordStackItem {
-    int *locals;
+    int depth;
     int localCount;
     int returnValue;
+    int dynamicLink;
     int returnAddress;
-    struct RecordStackItem *staticLink;
-    struct RecordStackItem *dynamicLink;
+    int savedDisplay;
+    int locals[];
 } RecordStackItem;
 
-// Container struct for a record linked list struct. Also keeps track
-// of the number of nodes in the stack.
+// A pre-decoded instruction for the threaded engine. The handler is the
+// address of the code that executes the instruction.
+typedef struct ThreadedInstruction {
+    void *handler;
+    int RField;
+    int LField;
+    int MField;
+} ThreadedInstruction;
+
+// How much of each step the interpreter traces.
+enum TraceModes {
+    TRACE_NONE,
+    TRACE_CPU,
+    TRACE_FULL
+};
+
+// Ways compiled code can finish.
+enum JitExits {
+    JIT_EXIT_KILL,
+    JIT_EXIT_FAILURE,
+    JIT_EXIT_DIVIDE_BY_ZERO,
+    JIT_EXIT_LOCAL_INDEX
+};
+
+// Container struct for the frame region. Also keeps track of the number of
+// records in the stack and where the top one starts. The display holds the
+// offset of the visible record at each lexical depth of the current record.
 typedef struct RecordStack {
+    int top;
+    int *frames;
     int records;
+    int capacity;
+    int *display;
+    int displayCapacity;
+    int currentOffset;
     RecordStackItem *currentRecord;
 } RecordStack;
 
+// A binary bytecode file mapped into memory. Its instructions are executed
+// straight out of the mapping.
+typedef struct MappedBytecode {
+    void *region;
+    size_t length;
+} MappedBytecode;
+
+// State shared between compiled code and the C functions it calls. Compiled
+// code keeps the address of this struct in rbx.
+typedef struct JitContext {
+    int registers[REGISTER_COUNT];
+    int errorValue;
+    CPU *cpu;
+    RecordStack *stack;
+    RecordStackItem *record;
+} JitContext;
+
+// Machine code produced by the JIT. The epilogue and entry are offsets into code.
+typedef struct JitBuffer {
+    unsigned char *code;
+    size_t capacity;
+    int length;
+    int entry;
+    int epilogue;
+} JitBuffer;
+
+// Compiled code is called with the context and returns a JitExits code.
+typedef int (*JitFunction)(JitContext*);
+
 // Machine functional prototypes.
 int startMachine(char*, int);
+int startMachineWithInstructions(Instruction*, int, int);
+int runProgram(Instruction*, int, int);
 CPU *createCPU(int);
 int destroyCPU(CPU*);
-int countInstructions(char*);
-Instruction *loadInstructions(char*, int);
+Instruction *readInstructions(char*, int*, MappedBytecode*);
+Instruction *loadInstructions(char*, int*);
+Instruction *mapInstructions(char*, int*, MappedBytecode*);
+int getTraceMode(int);
 int processInstructions(Instruction*, int, int);
+int runInstructions(CPU*, RecordStack*, Instruction*);
+int runCPUTracedInstructions(CPU*, RecordStack*, Instruction*);
+int runTracedInstructions(CPU*, RecordStack*, Instruction*, int);
 int fetchInstruction(CPU*, Instruction*);
 int executeInstruction(CPU*, RecordStack*);
 int destroyInstructions(Instruction*);
+int releaseInstructions(Instruction*, MappedBytecode*);
 
 // Operations functional prototypes.
 int invalidRegister(int);
-int invalidCPUState(CPU*, int);
 int operationLiteral(CPU*);
 int operationReturn(CPU*, RecordStack*);
+int *locateVariable(RecordStackItem*, int);
 int operationLoad(CPU*, RecordStack*);
 int operationStore(CPU*, RecordStack*);
 int operationCall(CPU*, RecordStack*);
@@ -70,13 +172,57 @@ int operationIsLessThan(CPU*);
 int operationIsLessThanOrEqualTo(CPU*);
 int operationIsGreaterThan(CPU*);
 int operationIsGreaterThanOrEqualTo(CPU*);
+int operationFusedLiteralStore(CPU*, RecordStack*);
+int operationFusedLoadLoadAdd(CPU*, RecordStack*);
+int operationFusedLoadLiteralArithmetic(CPU*, RecordStack*);
+int operationFusedCompareJump(CPU*);
+
+// Fusion functional prototypes.
+int matchFusion(Instruction*, int, int, Instruction*);
+Instruction *fuseInstructions(Instruction*, int, int*, int*);
+
+// Threaded functional prototypes.
+int processThreadedInstructions(Instruction*, int);
+
+// JIT functional prototypes.
+void jitPrint(int);
+void jitScan(int*);
+int jitAllocate(JitContext*, int);
+void writeByte(JitBuffer*, int);
+void writeInt(JitBuffer*, int);
+void writeContextOperand(JitBuffer*, int, int);
+void writeRecordOperand(JitBuffer*, int, int);
+void writeLoadRegister(JitBuffer*, int, int);
+void writeStoreRegister(JitBuffer*, int, int);
+void writeCall(JitBuffer*, void*);
+void writeExit(JitBuffer*, int, int);
+void writeLocalCheck(JitBuffer*, int);
+int compileInstruction(JitBuffer*, Instruction);
+JitFunction compileInstructions(Instruction*, int, JitBuffer*);
+int processCompiledInstructions(Instruction*, int);
+void destroyJitBuffer(JitBuffer*);
+
+// Transpiler functional prototypes.
+int transpileInstructions(char*, char*);
+void writeErrorLiteral(FILE*, int, ...);
+void writeTranspiledHeader(FILE*, char*, int, int);
+void writeTranspiledVariable(FILE*, Instruction);
+void writeTranspiledInstruction(FILE*, Instruction, int);
+
+// Verifier functional prototypes.
+int getRegisterCheck(int);
+int verifyInstruction(Instruction, int);
+int verifyInstructions(Instruction*, int);
 
 // Stack functional prototypes.
 RecordStack *initializeRecordStack(void);
+int reserveFrameSpace(RecordStack*, int);
+int reserveDisplaySpace(RecordStack*, int);
 int pushRecord(CPU*, RecordStack*);
 int popRecord(RecordStack*);
 RecordStackItem *peekRecord(RecordStack*);
-int allocateLocals(RecordStackItem*, int);
+RecordStackItem *getRecord(RecordStack*, int);
+int allocateLocals(RecordStack*, int);
 RecordStackItem *getDynamicParent(RecordStack*, int);
 RecordStackItem *getStaticParent(RecordStack*, int);
 int isEmpty(RecordStack*);
@@ -87,6 +233,7 @@ void printStackTraceHeader(int);
 void printStackTraceLine(CPU*, RecordStack*, int);
 void printRegisters(CPU*);
 void printCPU(CPU*);
-void printRecords(RecordStackItem*);
+void printRecords(RecordStack*);
+void printFusionReport(int*);
 
 #endif
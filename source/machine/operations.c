@@ -4,6 +4,10 @@
 #include <stdarg.h>
 #include "machine.h"
 
+// None of these operations check their register fields or jump targets. Every
+// program is run through verifyInstructions() before it starts, so those fields
+// are already known to be in bounds.
+
 // Return the validity of a particular register.
 int invalidRegister(int index) {
     if (index < 0 || index >= REGISTER_COUNT) {
@@ -16,38 +20,8 @@ int invalidRegister(int index) {
     }
 }
 
-// Return validity of CPU.
-int invalidCPUState(CPU *cpu, int registerCheck) {
-    if (cpu == NULL) {
-        printError(ERROR_NULL_POINTER);
-
-        return SIGNAL_TRUE;
-    }
-
-    // Check either only the RField or all three fields.
-    if (registerCheck == 1) {
-        if (invalidRegister(cpu->instRegister.RField)) {
-            return SIGNAL_TRUE;
-        }
-    }
-    else if (registerCheck == 3) {
-        if (invalidRegister(cpu->instRegister.RField) ||
-            invalidRegister(cpu->instRegister.LField) ||
-            invalidRegister(cpu->instRegister.MField)) {
-       
-            return SIGNAL_TRUE;
-        }
-    }
-        
-    return SIGNAL_FALSE;
-}
-
 // Load a literal value into register R.
 int operationLiteral(CPU *cpu) {
-    if (invalidCPUState(cpu, 1)) {
-        return SIGNAL_FAILURE;
-    }
-    
     cpu->registers[cpu->instRegister.RField] = cpu->instRegister.MField;
         
     return SIGNAL_SUCCESS;
@@ -56,12 +30,10 @@ int operationLiteral(CPU *cpu) {
 // Revert programCounter to the top activation record's returnAddress, then pops
 // the top record.
 int operationReturn(CPU *cpu, RecordStack *stack) {
-    if (invalidCPUState(cpu, 0)) {
-        return SIGNAL_FAILURE;
-    }
-    
-    if (stack == NULL) {
-        printError(ERROR_NULL_POINTER);
+
+    // The main environment has nowhere to return to.
+    if (stack->currentRecord->dynamicLink == NO_RECORD) {
+        printError(ERROR_NO_DYNAMIC_PARENT);
 
         return SIGNAL_FAILURE;
     }
@@ -71,21 +43,35 @@ int operationReturn(CPU *cpu, RecordStack *stack) {
     return popRecord(stack);
 }
 
-// Load a value from an activation record into a register.
-int operationLoad(CPU *cpu, RecordStack *stack) {
+// Return a pointer to the variable at an address in a record. Address zero is the
+// record's return value and everything above the offset is a local.
+int *locateVariable(RecordStackItem *record, int address) {
     int index;
-    RecordStackItem *desiredRecord;
-    
-    if (invalidCPUState(cpu, 1)) {
-        return SIGNAL_FAILURE;
+
+    if (address == 0) {
+        return &record->returnValue;
     }
 
-    if (stack == NULL) {
-        printError(ERROR_NULL_POINTER);
+    // Adjust index by the number of static space in each activation record.
+    index = address - INT_OFFSET;
 
-        return SIGNAL_FAILURE;
+    // The index is either out of bounds of the locals array, or the user is
+    // trying to get at some of the other activation record fields (like the
+    // dynamic link) and this isn't allowed.
+    if (index < 0 || index >= record->localCount) {
+        printError(ERROR_LOCAL_INDEX_OUT_OF_BOUNDS, index);
+
+        return NULL;
     }
 
+    return &record->locals[index];
+}
+
+// Load a value from an activation record into a register.
+int operationLoad(CPU *cpu, RecordStack *stack) {
+    int *variable;
+    RecordStackItem *desiredRecord;
+    
     // Get the static parent of the top level record, L levels down.
     if ((desiredRecord = getStaticParent(stack, cpu->instRegister.LField)) == NULL) {
         printError(ERROR_NO_STATIC_PARENT);
@@ -93,47 +79,19 @@ int operationLoad(CPU *cpu, RecordStack *stack) {
         return SIGNAL_FAILURE;
     }
 
-    // If index is zero, desired value is returnValue.
-    index = cpu->instRegister.MField;
-    if (index == 0) {
-        cpu->registers[cpu->instRegister.RField] = desiredRecord->returnValue;
-    }
-    else {
-    
-        // Adjust index by the number of static space in each activation record.
-        index -= INT_OFFSET;
-        
-        // If index is valid for the locals array, retrieve a value from said array.
-        if (index >= 0 && index < desiredRecord->localCount) {
-            cpu->registers[cpu->instRegister.RField] = desiredRecord->locals[index];
-        }
-       
-        // Otherwise value is bad, so operation fails.
-        else {
-            printError(ERROR_LOCAL_INDEX_OUT_OF_BOUNDS, index);
-
-            return SIGNAL_FAILURE;
-        }
+    if ((variable = locateVariable(desiredRecord, cpu->instRegister.MField)) == NULL) {
+        return SIGNAL_FAILURE;
     }
-    
+    cpu->registers[cpu->instRegister.RField] = *variable;
+
     return SIGNAL_SUCCESS;
 }
 
 // Load a value from a register into an activation record in the stack.
 int operationStore(CPU *cpu, RecordStack *stack) {
-    int index;
+    int *variable;
     RecordStackItem *desiredRecord;
 
-    if (invalidCPUState(cpu, 1)) {
-        return SIGNAL_FAILURE;
-    }
-    
-    if (stack == NULL) {
-        printError(ERROR_NULL_POINTER);
-
-        return SIGNAL_FAILURE;
-    }
-
     // Get the static parent of the top level record, L levels down.
     if ((desiredRecord = getStaticParent(stack, cpu->instRegister.LField)) == NULL) {
         printError(ERROR_NO_STATIC_PARENT);
@@ -141,42 +99,16 @@ int operationStore(CPU *cpu, RecordStack *stack) {
         return SIGNAL_FAILURE;
     }
 
-    index = cpu->instRegister.MField;
-    if (index == 0) {
-        desiredRecord->returnValue = cpu->registers[cpu->instRegister.RField];
-    }
-    else {
-        index -= INT_OFFSET;
-        
-        if (index >= 0 && index < desiredRecord->localCount) {
-            desiredRecord->locals[index] = cpu->registers[cpu->instRegister.RField];
-        }
-
-        // The index is either out of bounds of the locals array, or the user is
-        // trying to override some of the other activation record fields (like the
-        // dynamic link) and this isn't allowed.
-        else {
-            printError(ERROR_LOCAL_INDEX_OUT_OF_BOUNDS, index);
-
-            return SIGNAL_FAILURE;
-        }
+    if ((variable = locateVariable(desiredRecord, cpu->instRegister.MField)) == NULL) {
+        return SIGNAL_FAILURE;
     }
+    *variable = cpu->registers[cpu->instRegister.RField];
 
     return SIGNAL_SUCCESS;
 }
 
 // Push a new activation record environment onto the stack.
 int operationCall(CPU *cpu, RecordStack *stack) {
-    if (invalidCPUState(cpu, 0)) {
-        return SIGNAL_FAILURE;
-    }
-
-    if (stack == NULL) {
-        printError(ERROR_NULL_POINTER);
-
-        return SIGNAL_FAILURE;
-    }
-    
     pushRecord(cpu, stack);
     
     // Program jumps to subroutine.
@@ -187,25 +119,11 @@ int operationCall(CPU *cpu, RecordStack *stack) {
 
 // Allocate locals in top level activation record.
 int operationAllocate(CPU *cpu, RecordStack *stack) {
-    if (invalidCPUState(cpu, 0)) {
-        return SIGNAL_FAILURE;
-    }
-
-    if (stack == NULL) {
-        printError(ERROR_NULL_POINTER);
-
-        return SIGNAL_FAILURE;
-    }
-
-    return allocateLocals(stack->currentRecord, cpu->instRegister.MField - INT_OFFSET);
+    return allocateLocals(stack, cpu->instRegister.MField - INT_OFFSET);
 }
 
 // Update programCounter to value of M field.
 int operationJump(CPU *cpu) {
-    if (invalidCPUState(cpu, 0)) {
-        return SIGNAL_FAILURE;
-    }
-
     cpu->programCounter = cpu->instRegister.MField;
 
     return SIGNAL_SUCCESS;
@@ -213,10 +131,6 @@ int operationJump(CPU *cpu) {
 
 // Update programCounter to value of M field if register R is zero.
 int operationConditionalJump(CPU *cpu) {
-    if (invalidCPUState(cpu, 1)) {
-        return SIGNAL_FAILURE;
-    }
-
     if (cpu->registers[cpu->instRegister.RField] == 0) {
         cpu->programCounter = cpu->instRegister.MField;
     }
@@ -226,22 +140,12 @@ int operationConditionalJump(CPU *cpu) {
 
 // System calls capable of printing, scanning, and ending program.
 int operationSystemCall(CPU *cpu) {
-    if (invalidCPUState(cpu, 0)) {
-        return SIGNAL_FAILURE;
-    }
-
     if (cpu->instRegister.MField == CALL_PRINT) {
-        if (invalidRegister(cpu->instRegister.RField)) {
-            return SIGNAL_FAILURE;
-        }
         printf("%d\n", cpu->registers[cpu->instRegister.RField]);
         
         return SIGNAL_SUCCESS;
     }
     else if (cpu->instRegister.MField == CALL_SCAN) {
-        if (invalidRegister(cpu->instRegister.RField)) {
-            return SIGNAL_FAILURE;
-        }
         scanf("%d", &cpu->registers[cpu->instRegister.RField]);
         
         return SIGNAL_SUCCESS;
@@ -260,10 +164,6 @@ int operationSystemCall(CPU *cpu) {
 
 // Negate register L and save in register R.
 int operationNegate(CPU *cpu) {
-    if (invalidCPUState(cpu, 3)) {
-        return SIGNAL_FAILURE;
-    }
-
     cpu->registers[cpu->instRegister.RField] = 0 - cpu->registers[cpu->instRegister.LField];
 
     return SIGNAL_SUCCESS;
@@ -271,10 +171,6 @@ int operationNegate(CPU *cpu) {
 
 // Add registers L and M into register R.
 int operationAdd(CPU *cpu) {
-    if (invalidCPUState(cpu, 3)) {
-        return SIGNAL_FAILURE;
-    }
-    
     cpu->registers[cpu->instRegister.RField] = cpu->registers[cpu->instRegister.LField] +
                                                cpu->registers[cpu->instRegister.MField];
     return SIGNAL_SUCCESS;
@@ -282,10 +178,6 @@ int operationAdd(CPU *cpu) {
 
 // Subract register M from register L and store in register R.
 int operationSubtract(CPU *cpu) {
-    if (invalidCPUState(cpu, 3)) {
-        return SIGNAL_FAILURE;
-    }
-    
     cpu->registers[cpu->instRegister.RField] = cpu->registers[cpu->instRegister.LField] -
                                                cpu->registers[cpu->instRegister.MField];
     return SIGNAL_SUCCESS;
@@ -293,10 +185,6 @@ int operationSubtract(CPU *cpu) {
 
 // Multiply registers L and M and store in register R.
 int operationMultiply(CPU *cpu) {
-    if (invalidCPUState(cpu, 3)) {
-        return SIGNAL_FAILURE;
-    }
-    
     cpu->registers[cpu->instRegister.RField] = cpu->registers[cpu->instRegister.LField] *
                                                cpu->registers[cpu->instRegister.MField];
     return SIGNAL_SUCCESS;
@@ -304,10 +192,6 @@ int operationMultiply(CPU *cpu) {
 
 // Divide register L by register M and store in register R.
 int operationDivide(CPU *cpu) {
-    if (invalidCPUState(cpu, 3)) {
-        return SIGNAL_FAILURE;
-    }
-    
     if (cpu->registers[cpu->instRegister.MField] == 0) {
         printError(ERROR_DIVIDE_BY_ZERO);
         
@@ -321,10 +205,6 @@ int operationDivide(CPU *cpu) {
 
 // Store 1 in register R if register R is odd, else store 0.
 int operationIsOdd(CPU *cpu) {
-    if (invalidCPUState(cpu, 3)) {
-        return SIGNAL_FAILURE;
-    }
-    
     if ((cpu->registers[cpu->instRegister.RField] % 2) != 0) {
         cpu->registers[cpu->instRegister.RField] = 1;
     }
@@ -337,10 +217,6 @@ int operationIsOdd(CPU *cpu) {
 
 // Store remainder of division of register L by register M in register R.
 int operationModulus(CPU *cpu) {
-    if (invalidCPUState(cpu, 3)) {
-        return SIGNAL_FAILURE;
-    }
-    
     cpu->registers[cpu->instRegister.RField] = cpu->registers[cpu->instRegister.LField] %
                                                cpu->registers[cpu->instRegister.MField];
     return SIGNAL_SUCCESS;
@@ -348,10 +224,6 @@ int operationModulus(CPU *cpu) {
 
 // Store 1 in register R if registers L and M are equal, else store 0.
 int operationIsEqual(CPU *cpu) {
-    if (invalidCPUState(cpu, 3)) {
-        return SIGNAL_FAILURE;
-    }
-    
     cpu->registers[cpu->instRegister.RField] = (cpu->registers[cpu->instRegister.LField] ==
                                                 cpu->registers[cpu->instRegister.MField]);
     return SIGNAL_SUCCESS;
@@ -359,10 +231,6 @@ int operationIsEqual(CPU *cpu) {
 
 // Store 1 in register R if registers L and M are not equal, else store 0.
 int operationIsNotEqual(CPU *cpu) {
-    if (invalidCPUState(cpu, 3)) {
-        return SIGNAL_FAILURE;
-    }
-    
     cpu->registers[cpu->instRegister.RField] = (cpu->registers[cpu->instRegister.LField] !=
                                                 cpu->registers[cpu->instRegister.MField]);
     return SIGNAL_SUCCESS;
@@ -370,10 +238,6 @@ int operationIsNotEqual(CPU *cpu) {
 
 // Store 1 in register R if register L is less than register M, else store 0.
 int operationIsLessThan(CPU *cpu) {
-    if (invalidCPUState(cpu, 3)) {
-        return SIGNAL_FAILURE;
-    }
-    
     cpu->registers[cpu->instRegister.RField] = (cpu->registers[cpu->instRegister.LField] <
                                                 cpu->registers[cpu->instRegister.MField]);
     return SIGNAL_SUCCESS;
@@ -381,10 +245,6 @@ int operationIsLessThan(CPU *cpu) {
 
 // Store 1 in register R if register L is less than or equal to register M, else store 0.
 int operationIsLessThanOrEqualTo(CPU *cpu) {
-    if (invalidCPUState(cpu, 3)) {
-        return SIGNAL_FAILURE;
-    }
-    
     cpu->registers[cpu->instRegister.RField] = (cpu->registers[cpu->instRegister.LField] <=
                                                 cpu->registers[cpu->instRegister.MField]);
     return SIGNAL_SUCCESS;
@@ -392,10 +252,6 @@ int operationIsLessThanOrEqualTo(CPU *cpu) {
 
 // Store 1 in register R if register L is greater than to register M, else store 0.
 int operationIsGreaterThan(CPU *cpu) {
-    if (invalidCPUState(cpu, 3)) {
-        return SIGNAL_FAILURE;
-    }
-    
     cpu->registers[cpu->instRegister.RField] = (cpu->registers[cpu->instRegister.LField] >
                                                 cpu->registers[cpu->instRegister.MField]);
     return SIGNAL_SUCCESS;
@@ -403,11 +259,88 @@ int operationIsGreaterThan(CPU *cpu) {
 
 // Store 1 in register R if register L is greater than or equal to register M, else store 0.
 int operationIsGreaterThanOrEqualTo(CPU *cpu) {
-    if (invalidCPUState(cpu, 3)) {
-        return SIGNAL_FAILURE;
-    }
-    
     cpu->registers[cpu->instRegister.RField] = (cpu->registers[cpu->instRegister.LField] >=
                                                 cpu->registers[cpu->instRegister.MField]);
     return SIGNAL_SUCCESS;
 }
+
+// Store literal L in register R and in the current record at address M.
+int operationFusedLiteralStore(CPU *cpu, RecordStack *stack) {
+    int *variable;
+
+    if ((variable = locateVariable(stack->currentRecord, cpu->instRegister.MField)) == NULL) {
+        return SIGNAL_FAILURE;
+    }
+    cpu->registers[cpu->instRegister.RField] = cpu->instRegister.LField;
+    *variable = cpu->instRegister.LField;
+
+    return SIGNAL_SUCCESS;
+}
+
+// Load addresses L and M of the current record into registers R and R + 1,
+// then add them into register R.
+int operationFusedLoadLoadAdd(CPU *cpu, RecordStack *stack) {
+    int *left;
+    int *right;
+    int RField;
+
+    if ((left = locateVariable(stack->currentRecord, cpu->instRegister.LField)) == NULL ||
+        (right = locateVariable(stack->currentRecord, cpu->instRegister.MField)) == NULL) {
+
+        return SIGNAL_FAILURE;
+    }
+
+    RField = cpu->instRegister.RField;
+    cpu->registers[RField + 1] = *right;
+    cpu->registers[RField] = *left + *right;
+
+    return SIGNAL_SUCCESS;
+}
+
+// Load address L of the current record into register R and literal M into
+// register R + 1, then add or subtract them into register R.
+int operationFusedLoadLiteralArithmetic(CPU *cpu, RecordStack *stack) {
+    int *left;
+    int RField;
+
+    if ((left = locateVariable(stack->currentRecord, cpu->instRegister.LField)) == NULL) {
+        return SIGNAL_FAILURE;
+    }
+
+    RField = cpu->instRegister.RField;
+    cpu->registers[RField + 1] = cpu->instRegister.MField;
+    if (cpu->instRegister.opCode == FUSED_LOD_LIT_ADD) {
+        cpu->registers[RField] = *left + cpu->instRegister.MField;
+    }
+    else {
+        cpu->registers[RField] = *left - cpu->instRegister.MField;
+    }
+
+    return SIGNAL_SUCCESS;
+}
+
+// Compare registers R and L into register R, then jump to M if the result is zero.
+int operationFusedCompareJump(CPU *cpu) {
+    int left;
+    int right;
+    int result;
+
+    left = cpu->registers[cpu->instRegister.RField];
+    right = cpu->registers[cpu->instRegister.LField];
+
+    switch (cpu->instRegister.opCode) {
+        case FUSED_EQL_JPC: result = (left == right); break;
+        case FUSED_NEQ_JPC: result = (left != right); break;
+        case FUSED_LSS_JPC: result = (left < right); break;
+        case FUSED_LEQ_JPC: result = (left <= right); break;
+        case FUSED_GTR_JPC: result = (left > right); break;
+        default:            result = (left >= right); break;
+    }
+
+    cpu->registers[cpu->instRegister.RField] = result;
+    if (result == 0) {
+        cpu->programCounter = cpu->instRegister.MField;
+    }
+
+    return SIGNAL_SUCCESS;
+}
@@ -36,7 +36,7 @@ void printStackTraceLine(CPU *cpu, RecordStack *stack, int options) {
     
     printCPU(cpu);
     if (checkOption(&options, OPTION_TRACE_RECORDS)) {
-        printRecords(stack->currentRecord);
+        printRecords(stack);
     }
     if (checkOption(&options, OPTION_TRACE_REGISTERS)) {
         printRegisters(cpu);
@@ -99,20 +99,52 @@ void printCPU(CPU *cpu) {
                                      cpu->programCounter);
 }
 
-// Recursively print a stack of records.
-void printRecords(RecordStackItem *record) {
+// Print a stack of records, bottom first. Records sit back to back in the
+// frame region, so each one starts right after the previous record's locals.
+void printRecords(RecordStack *stack) {
     int i;
-    
-    if (record == NULL) {
+    int offset;
+    RecordStackItem *record;
+
+    if (stack == NULL) {
         return;
     }
-   
-    // Recursively print the rest of the stack first.
-    printRecords(record->dynamicLink);
-    printf("%-3d %-5d", record->returnValue, record->returnAddress);
 
-    for (i = 0; i < record->localCount; i++) {
-        printf(" %-3d", record->locals[i]);
+    for (offset = 0; offset < stack->top; offset += RECORD_HEADER_SIZE + record->localCount) {
+        record = getRecord(stack, offset);
+        printf("%-3d %-5d", record->returnValue, record->returnAddress);
+
+        for (i = 0; i < record->localCount; i++) {
+            printf(" %-3d", record->locals[i]);
+        }
+        printf(" | ");
+    }
+}
+
+// Print how many times each fused instruction was applied.
+void printFusionReport(int *fusions) {
+    int i;
+    int total;
+
+    char *patterns[] = {
+        "LIT STO", "LOD LOD ADD", "LOD LIT ADD", "LOD LIT SUB",
+        "EQL JPC", "NEQ JPC", "LSS JPC", "LEQ JPC", "GTR JPC", "GEQ JPC"
+    };
+
+    if (fusions == NULL) {
+        printError(ERROR_NULL_POINTER);
+
+        return;
+    }
+
+    printf("Fusions:\n");
+    printf("PATTERN      COUNT\n");
+    printf("------------------\n");
+
+    total = 0;
+    for (i = 0; i < FUSION_PATTERNS; i++) {
+        printf("%-12s %d\n", patterns[i], fusions[i]);
+        total += fusions[i];
     }
-    printf(" | ");
+    printf("%-12s %d\n\n", "TOTAL", total);
 }
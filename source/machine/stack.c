@@ -1,64 +1,178 @@
 // Part of Plum by Tiger Sachse.
 
 #include <stdlib.h>
+#include <limits.h>
 #include "machine.h"
 
 // Return an empty record stack.
 RecordStack *initializeRecordStack(void) {
-    return calloc(1, sizeof(RecordStack));
+    int i;
+    RecordStack *stack;
+
+    if ((stack = calloc(1, sizeof(RecordStack))) == NULL) {
+        return NULL;
+    }
+
+    // All records live back to back in this one region.
+    if ((stack->frames = malloc(sizeof(int) * INITIAL_FRAME_CAPACITY)) == NULL) {
+        free(stack);
+
+        return NULL;
+    }
+
+    if ((stack->display = malloc(sizeof(int) * INITIAL_DISPLAY_CAPACITY)) == NULL) {
+        free(stack->frames);
+        free(stack);
+
+        return NULL;
+    }
+
+    stack->capacity = INITIAL_FRAME_CAPACITY;
+    stack->displayCapacity = INITIAL_DISPLAY_CAPACITY;
+    stack->currentOffset = NO_RECORD;
+    for (i = 0; i < INITIAL_DISPLAY_CAPACITY; i++) {
+        stack->display[i] = NO_RECORD;
+    }
+
+    return stack;
+}
+
+// Make room for at least size more ints at the top of the region. Records are
+// addressed by offset, so only currentRecord needs fixing after a move. The
+// region never grows past INT_MAX ints, so that offsets still fit in an int.
+int reserveFrameSpace(RecordStack *stack, int size) {
+    int *frames;
+    long capacity;
+
+    if (size < 0 || size > INT_MAX - stack->top) {
+        printError(ERROR_OUT_OF_MEMORY);
+
+        return SIGNAL_FAILURE;
+    }
+
+    if (stack->top + size <= stack->capacity) {
+        return SIGNAL_SUCCESS;
+    }
+
+    capacity = stack->capacity;
+    while (stack->top + size > capacity) {
+        capacity = (capacity > INT_MAX / 2) ? INT_MAX : capacity * 2;
+    }
+
+    if ((frames = realloc(stack->frames, sizeof(int) * (size_t) capacity)) == NULL) {
+        printError(ERROR_OUT_OF_MEMORY);
+
+        return SIGNAL_FAILURE;
+    }
+
+    stack->frames = frames;
+    stack->capacity = (int) capacity;
+    stack->currentRecord = getRecord(stack, stack->currentOffset);
+
+    return SIGNAL_SUCCESS;
+}
+
+// Make sure the display has an entry for the given depth.
+int reserveDisplaySpace(RecordStack *stack, int depth) {
+    int i;
+    int *display;
+    int capacity;
+
+    if (depth < stack->displayCapacity) {
+        return SIGNAL_SUCCESS;
+    }
+
+    capacity = stack->displayCapacity;
+    while (depth >= capacity) {
+        capacity *= 2;
+    }
+
+    if ((display = realloc(stack->display, sizeof(int) * capacity)) == NULL) {
+        printError(ERROR_OUT_OF_MEMORY);
+
+        return SIGNAL_FAILURE;
+    }
+
+    for (i = stack->displayCapacity; i < capacity; i++) {
+        display[i] = NO_RECORD;
+    }
+    stack->display = display;
+    stack->displayCapacity = capacity;
+
+    return SIGNAL_SUCCESS;
 }
 
 // Push a new record onto the stack.
 int pushRecord(CPU *cpu, RecordStack *stack) {
+    int depth;
+    int offset;
     RecordStackItem *new;
-    
+
     if (cpu == NULL || stack == NULL) {
         printError(ERROR_NULL_POINTER);
 
         return SIGNAL_FAILURE;
     }
 
+    // The new record sits one level below its static parent. The main
+    // environment is its own static parent, at depth zero.
+    if (stack->currentRecord == NULL) {
+        depth = 0;
+    }
+    else {
+        depth = stack->currentRecord->depth - cpu->instRegister.LField;
+        depth = (depth < 0) ? 1 : depth + 1;
+    }
+
     // If there is not enough memory for a new record, return SIGNAL_FAILURE.
-    if ((new = malloc(sizeof(RecordStackItem))) == NULL) {
-        printError(ERROR_OUT_OF_MEMORY);
-        
+    if (reserveFrameSpace(stack, RECORD_HEADER_SIZE) == SIGNAL_FAILURE ||
+        reserveDisplaySpace(stack, depth) == SIGNAL_FAILURE) {
+
         return SIGNAL_FAILURE;
     }
 
-    new->locals = NULL;
+    // The new record starts where the current record's locals end.
+    offset = stack->top;
+    new = getRecord(stack, offset);
+
+    new->depth = depth;
     new->localCount = 0;
     new->returnValue = 0;
     new->returnAddress = cpu->programCounter;
-    new->dynamicLink = stack->currentRecord;
-    if ((new->staticLink = getStaticParent(stack, cpu->instRegister.LField)) == NULL) {
-        new->staticLink = new; 
-    }
-    
+    new->dynamicLink = stack->currentOffset;
+
+    // Take over the display entry for this depth, remembering the old one.
+    new->savedDisplay = stack->display[depth];
+    stack->display[depth] = offset;
+
     // Set the top of the stack to be new.
+    stack->top += RECORD_HEADER_SIZE;
+    stack->currentOffset = offset;
     stack->currentRecord = new;
     stack->records++;
 
     return SIGNAL_SUCCESS;
 }
 
-// Remove the top record from the stack and free any associated dynamic memory.
+// Remove the top record from the stack. Its locals go with it.
 int popRecord(RecordStack *stack) {
     int returnValue;
-    RecordStackItem *next;
 
     if (stack == NULL || stack->currentRecord == NULL) {
         printError(ERROR_NULL_POINTER);
-        
+
         return SIGNAL_FAILURE;
     }
 
-    next = stack->currentRecord->dynamicLink;
     returnValue = stack->currentRecord->returnValue;
-    free(stack->currentRecord->locals);
-    free(stack->currentRecord);
-   
+
+    // Hand the display entry back to whoever held it before this record.
+    stack->display[stack->currentRecord->depth] = stack->currentRecord->savedDisplay;
+
     // Set the top of the stack to the record below the old top.
-    stack->currentRecord = next;
+    stack->top = stack->currentOffset;
+    stack->currentOffset = stack->currentRecord->dynamicLink;
+    stack->currentRecord = getRecord(stack, stack->currentOffset);
     stack->records--;
 
     return returnValue;
@@ -69,29 +183,38 @@ RecordStackItem *peekRecord(RecordStack *stack) {
     return (stack == NULL) ? NULL : stack->currentRecord;
 }
 
-// Allocate the locals array in the given record.
-int allocateLocals(RecordStackItem *record, int localCount) {
-    if (record == NULL || record->locals != NULL) {
+// Return the record at an offset in the frame region, or NULL for NO_RECORD.
+RecordStackItem *getRecord(RecordStack *stack, int offset) {
+    return (offset == NO_RECORD) ? NULL : (RecordStackItem*) (stack->frames + offset);
+}
+
+// Allocate the locals array in the top record, directly after its header.
+int allocateLocals(RecordStack *stack, int localCount) {
+    int i;
+
+    if (stack == NULL || stack->currentRecord == NULL ||
+        stack->currentRecord->localCount > 0) {
+
         printError(ERROR_NULL_POINTER);
-        
+
         return SIGNAL_FAILURE;
     }
 
-    record->localCount = localCount;
-    
-    // Set locals to NULL if there aren't any parameters.
+    // Nothing to do if there aren't any locals.
     if (localCount < 1) {
-        record->locals = NULL;
+        return SIGNAL_SUCCESS;
     }
-    
-    // Else make a new locals array in the record.
-    else if ((record->locals = calloc(1, sizeof(int) * localCount)) == NULL) {
-        record->localCount = 0;
-        printError(ERROR_OUT_OF_MEMORY);
 
+    if (reserveFrameSpace(stack, localCount) == SIGNAL_FAILURE) {
         return SIGNAL_FAILURE;
     }
-    
+
+    for (i = 0; i < localCount; i++) {
+        stack->currentRecord->locals[i] = 0;
+    }
+    stack->currentRecord->localCount = localCount;
+    stack->top += localCount;
+
     return SIGNAL_SUCCESS;
 }
 
@@ -101,42 +224,42 @@ RecordStackItem *getDynamicParent(RecordStack *stack, int levels) {
 
     if (stack == NULL) {
         printError(ERROR_NULL_POINTER);
-        
+
         return NULL;
     }
-    
+
     desired = stack->currentRecord;
-  
+
     // While there are still more levels to go and desired hasn't reached
     // the bottom of the stack, go deeper.
     while (levels > 0 && desired != NULL) {
-        desired = desired->dynamicLink;
+        desired = getRecord(stack, desired->dynamicLink);
         levels--;
     }
 
     return desired;
 }
 
-// Seek down the stack through static links (in lexicographical order).
+// Find the record visible L levels out from the current record. The display
+// holds one record per lexical depth, so this is a single lookup no matter
+// how deeply the current record is nested.
 RecordStackItem *getStaticParent(RecordStack *stack, int levels) {
-    RecordStackItem *desired;
+    int depth;
 
     if (stack == NULL) {
         printError(ERROR_NULL_POINTER);
-        
+
         return NULL;
     }
 
-    desired = stack->currentRecord;
-    
-    // While there are still more levels to go and desired hasn't reached
-    // the bottom of the stack, go deeper.
-    while (levels > 0 && desired != NULL) {
-        desired = desired->staticLink;
-        levels--;
+    if (stack->currentRecord == NULL || levels <= 0) {
+        return stack->currentRecord;
     }
 
-    return desired;
+    // Walking past the main environment stays on the main environment.
+    depth = stack->currentRecord->depth - levels;
+
+    return getRecord(stack, stack->display[(depth < 0) ? 0 : depth]);
 }
 
 // Return if stack is empty or not.
@@ -146,13 +269,13 @@ int isEmpty(RecordStack *stack) {
 
 // Destroy the record stack.
 RecordStack *destroyRecordStack(RecordStack *stack) {
-    
-    // Pop all records out of the stack.
-    while (!isEmpty(stack)) {
-        popRecord(stack);
+    if (stack == NULL) {
+        return NULL;
     }
 
-    // Free the stack container.
+    // Every record lives in the one region, so it all goes at once.
+    free(stack->frames);
+    free(stack->display);
     free(stack);
 
     return NULL;
@@ -0,0 +1,310 @@
+// Part of Plum by Tiger Sachse.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "machine.h"
+
+// Fetch the instruction at next and jump straight to its handler.
+#define DISPATCH() do { current = next++; goto *current->handler; } while (0)
+
+// Registers addressed by the current instruction.
+#define R registers[current->RField]
+#define L registers[current->LField]
+#define M registers[current->MField]
+
+// The record the current instruction's L field refers to, looked up in the
+// display (see getStaticParent()).
+#define VISIBLE_RECORD() ((current->LField == 0) ? stack->currentRecord : \
+    getRecord(stack, stack->display[(stack->currentRecord->depth > current->LField) ? \
+                                    stack->currentRecord->depth - current->LField : 0]))
+
+// Point variable at an address in a record, failing like LOD and STO do when
+// the address is outside the record's locals (see locateVariable()).
+#define LOCATE(variable, record, address) do { \
+    if ((address) == 0) { \
+        variable = &(record)->returnValue; \
+    } \
+    else if ((index = (address) - INT_OFFSET) >= 0 && index < (record)->localCount) { \
+        variable = &(record)->locals[index]; \
+    } \
+    else { \
+        printError(ERROR_LOCAL_INDEX_OUT_OF_BOUNDS, index); \
+        returnValue = SIGNAL_FAILURE; \
+        goto finish; \
+    } \
+} while (0)
+
+// Process the provided instructions using direct-threaded dispatch. The
+// instructions are decoded into handler addresses once, then each handler
+// jumps straight to the next one without returning to a central loop.
+int processThreadedInstructions(Instruction *instructions, int instructionCount) {
+    int i;
+    int index;
+    CPU *cpu;
+    int *registers;
+    int *variable;
+    int *other;
+    int returnValue;
+    RecordStack *stack;
+    RecordStackItem *record;
+    ThreadedInstruction *code;
+    ThreadedInstruction *current;
+    ThreadedInstruction *next;
+
+    // Handler addresses indexed by opcode. Index zero is unused.
+    static void *handlers[] = {
+        NULL,
+        &&handleLiteral, &&handleReturn, &&handleLoad, &&handleStore,
+        &&handleCall, &&handleAllocate, &&handleJump,
+        &&handleConditionalJump, &&handleSystemCall, &&handleNegate,
+        &&handleAdd, &&handleSubtract, &&handleMultiply,
+        &&handleDivide, &&handleIsOdd, &&handleModulus,
+        &&handleIsEqual, &&handleIsNotEqual, &&handleIsLessThan,
+        &&handleIsLessThanOrEqualTo, &&handleIsGreaterThan,
+        &&handleIsGreaterThanOrEqualTo,
+        &&handleFusedLiteralStore, &&handleFusedLoadLoadAdd,
+        &&handleFusedLoadLiteralAdd, &&handleFusedLoadLiteralSubtract,
+        &&handleFusedIsEqualJump, &&handleFusedIsNotEqualJump,
+        &&handleFusedIsLessThanJump, &&handleFusedIsLessThanOrEqualToJump,
+        &&handleFusedIsGreaterThanJump, &&handleFusedIsGreaterThanOrEqualToJump
+    };
+
+    if (instructions == NULL || instructionCount == 0) {
+        printError(ERROR_NULL_POINTER);
+
+        return SIGNAL_FAILURE;
+    }
+
+    if ((code = malloc(sizeof(ThreadedInstruction) * instructionCount)) == NULL) {
+        printError(ERROR_OUT_OF_MEMORY);
+
+        return SIGNAL_FAILURE;
+    }
+
+    // Decode every instruction into its handler address. The instructions have
+    // been verified, so every opcode has a handler and every target is valid.
+    for (i = 0; i < instructionCount; i++) {
+        code[i].handler = handlers[instructions[i].opCode];
+        code[i].RField = instructions[i].RField;
+        code[i].LField = instructions[i].LField;
+        code[i].MField = instructions[i].MField;
+    }
+
+    if ((cpu = createCPU(instructionCount)) == NULL) {
+        free(code);
+        printError(ERROR_OUT_OF_MEMORY);
+
+        return SIGNAL_FAILURE;
+    }
+
+    if ((stack = initializeRecordStack()) == NULL) {
+        free(code);
+        destroyCPU(cpu);
+        printError(ERROR_OUT_OF_MEMORY);
+
+        return SIGNAL_FAILURE;
+    }
+
+    // Push an initial record onto the stack for the main environment.
+    pushRecord(cpu, stack);
+
+    registers = cpu->registers;
+    returnValue = SIGNAL_SUCCESS;
+
+    next = code;
+    DISPATCH();
+
+    handleLiteral:
+        R = current->MField;
+        DISPATCH();
+
+    handleReturn:
+
+        // The main environment has nowhere to return to.
+        if (stack->currentRecord->dynamicLink == NO_RECORD) {
+            printError(ERROR_NO_DYNAMIC_PARENT);
+            returnValue = SIGNAL_FAILURE;
+            goto finish;
+        }
+        next = code + stack->currentRecord->returnAddress;
+        popRecord(stack);
+        DISPATCH();
+
+    handleLoad:
+        record = VISIBLE_RECORD();
+        LOCATE(variable, record, current->MField);
+        R = *variable;
+        DISPATCH();
+
+    handleStore:
+        record = VISIBLE_RECORD();
+        LOCATE(variable, record, current->MField);
+        *variable = R;
+        DISPATCH();
+
+    handleCall:
+        cpu->programCounter = (int) (next - code);
+        cpu->instRegister.LField = current->LField;
+        if (pushRecord(cpu, stack) == SIGNAL_FAILURE) {
+            returnValue = SIGNAL_FAILURE;
+            goto finish;
+        }
+        next = code + current->MField;
+        DISPATCH();
+
+    handleAllocate:
+        if (allocateLocals(stack, current->MField - INT_OFFSET) == SIGNAL_FAILURE) {
+            returnValue = SIGNAL_FAILURE;
+            goto finish;
+        }
+        DISPATCH();
+
+    handleJump:
+        next = code + current->MField;
+        DISPATCH();
+
+    handleConditionalJump:
+        if (R == 0) {
+            next = code + current->MField;
+        }
+        DISPATCH();
+
+    handleSystemCall:
+        if (current->MField == CALL_PRINT) {
+            printf("%d\n", R);
+        }
+        else if (current->MField == CALL_SCAN) {
+            scanf("%d", &R);
+        }
+        else {
+            goto finish;
+        }
+        DISPATCH();
+
+    handleNegate:
+        R = 0 - L;
+        DISPATCH();
+
+    handleAdd:
+        R = L + M;
+        DISPATCH();
+
+    handleSubtract:
+        R = L - M;
+        DISPATCH();
+
+    handleMultiply:
+        R = L * M;
+        DISPATCH();
+
+    handleDivide:
+        if (M == 0) {
+            printError(ERROR_DIVIDE_BY_ZERO);
+            returnValue = SIGNAL_FAILURE;
+            goto finish;
+        }
+        R = L / M;
+        DISPATCH();
+
+    handleIsOdd:
+        R = ((R % 2) != 0);
+        DISPATCH();
+
+    handleModulus:
+        R = L % M;
+        DISPATCH();
+
+    handleIsEqual:
+        R = (L == M);
+        DISPATCH();
+
+    handleIsNotEqual:
+        R = (L != M);
+        DISPATCH();
+
+    handleIsLessThan:
+        R = (L < M);
+        DISPATCH();
+
+    handleIsLessThanOrEqualTo:
+        R = (L <= M);
+        DISPATCH();
+
+    handleIsGreaterThan:
+        R = (L > M);
+        DISPATCH();
+
+    handleIsGreaterThanOrEqualTo:
+        R = (L >= M);
+        DISPATCH();
+
+    // Fused instructions. Operands are packed as described in matchFusion().
+    handleFusedLiteralStore:
+        LOCATE(variable, stack->currentRecord, current->MField);
+        R = current->LField;
+        *variable = current->LField;
+        DISPATCH();
+
+    handleFusedLoadLoadAdd:
+        LOCATE(variable, stack->currentRecord, current->LField);
+        LOCATE(other, stack->currentRecord, current->MField);
+        registers[current->RField + 1] = *other;
+        R = *variable + *other;
+        DISPATCH();
+
+    handleFusedLoadLiteralAdd:
+        LOCATE(variable, stack->currentRecord, current->LField);
+        registers[current->RField + 1] = current->MField;
+        R = *variable + current->MField;
+        DISPATCH();
+
+    handleFusedLoadLiteralSubtract:
+        LOCATE(variable, stack->currentRecord, current->LField);
+        registers[current->RField + 1] = current->MField;
+        R = *variable - current->MField;
+        DISPATCH();
+
+    handleFusedIsEqualJump:
+        if ((R = (R == L)) == 0) {
+            next = code + current->MField;
+        }
+        DISPATCH();
+
+    handleFusedIsNotEqualJump:
+        if ((R = (R != L)) == 0) {
+            next = code + current->MField;
+        }
+        DISPATCH();
+
+    handleFusedIsLessThanJump:
+        if ((R = (R < L)) == 0) {
+            next = code + current->MField;
+        }
+        DISPATCH();
+
+    handleFusedIsLessThanOrEqualToJump:
+        if ((R = (R <= L)) == 0) {
+            next = code + current->MField;
+        }
+        DISPATCH();
+
+    handleFusedIsGreaterThanJump:
+        if ((R = (R > L)) == 0) {
+            next = code + current->MField;
+        }
+        DISPATCH();
+
+    handleFusedIsGreaterThanOrEqualToJump:
+        if ((R = (R >= L)) == 0) {
+            next = code + current->MField;
+        }
+        DISPATCH();
+
+    // Stay memory safe!
+    finish:
+    free(code);
+    destroyCPU(cpu);
+    destroyRecordStack(stack);
+
+    return returnValue;
+}
@@ -0,0 +1,384 @@
+// Part of Plum by Tiger Sachse.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include "machine.h"
+
+// Transpile the bytecode file at inFile into a self-contained C program at
+// outFile. The program behaves exactly like the machine would: it prints and
+// scans the same way, and stops with the same error messages.
+int transpileInstructions(char *inFile, char *outFile) {
+    FILE *f;
+    int i;
+    int hasReturn;
+    int hasRegisters;
+    int returnValue;
+    int instructionCount;
+    char *isTarget;
+    Instruction *instructions;
+    MappedBytecode mapping = { NULL, 0 };
+
+    if (inFile == NULL || outFile == NULL) {
+        printError(ERROR_NULL_POINTER);
+
+        return SIGNAL_FAILURE;
+    }
+
+    // Only verified programs are transpiled, so the generated code needs no
+    // more checks than the machine makes at runtime.
+    if ((instructions = readInstructions(inFile, &instructionCount, &mapping)) == NULL) {
+        return SIGNAL_FAILURE;
+    }
+
+    if ((isTarget = calloc(instructionCount, sizeof(char))) == NULL) {
+        releaseInstructions(instructions, &mapping);
+        printError(ERROR_OUT_OF_MEMORY);
+
+        return SIGNAL_FAILURE;
+    }
+
+    if ((f = fopen(outFile, "w")) == NULL) {
+        free(isTarget);
+        releaseInstructions(instructions, &mapping);
+        printError(ERROR_FILE_NOT_FOUND, outFile);
+
+        return SIGNAL_FAILURE;
+    }
+
+    // Only instructions that are jumped to or returned to get a label, and
+    // the registers are only declared if some instruction uses them.
+    hasReturn = 0;
+    hasRegisters = 0;
+    for (i = 0; i < instructionCount; i++) {
+        if (instructions[i].opCode == RTN) {
+            hasReturn = 1;
+        }
+        if (instructions[i].opCode != RTN && instructions[i].opCode != CAL &&
+            instructions[i].opCode != INC && instructions[i].opCode != JMP &&
+            (instructions[i].opCode != SIO || instructions[i].MField != CALL_KILL)) {
+
+            hasRegisters = 1;
+        }
+        if (instructions[i].opCode == JMP || instructions[i].opCode == JPC ||
+            instructions[i].opCode == CAL) {
+
+            isTarget[instructions[i].MField] = 1;
+        }
+        if (instructions[i].opCode == CAL) {
+            isTarget[i + 1] = 1;
+        }
+    }
+
+    writeTranspiledHeader(f, inFile, hasReturn, hasRegisters);
+
+    for (i = 0; i < instructionCount; i++) {
+        if (isTarget[i]) {
+            fprintf(f, "instruction%d:\n", i);
+        }
+        writeTranspiledInstruction(f, instructions[i], i);
+    }
+
+    // Procedures return through their saved return address, which is always
+    // the instruction after some CAL.
+    if (hasReturn) {
+        fprintf(f, "\nreturnToCaller:\n");
+        fprintf(f, "    switch (returnAddress) {\n");
+        for (i = 0; i < instructionCount; i++) {
+            if (instructions[i].opCode == CAL) {
+                fprintf(f, "        case %d: goto instruction%d;\n", i + 1, i + 1);
+            }
+        }
+        fprintf(f, "    }\n\n");
+        fprintf(f, "    return 0;\n");
+    }
+    fprintf(f, "}\n");
+
+    returnValue = (ferror(f)) ? SIGNAL_FAILURE : SIGNAL_SUCCESS;
+    if (fclose(f) != 0 || returnValue == SIGNAL_FAILURE) {
+        printError(ERROR_WRITING_FILE_FAILED);
+        returnValue = SIGNAL_FAILURE;
+    }
+
+    // Stay memory safe!
+    free(isTarget);
+    releaseInstructions(instructions, &mapping);
+
+    return returnValue;
+}
+
+// Write an error message as a C string literal. Error messages never contain
+// quotes or backslashes, so they need no escaping.
+void writeErrorLiteral(FILE *f, int errorCode, ...) {
+    va_list arguments;
+    char error[MAX_ERROR_LENGTH];
+
+    va_start(arguments, errorCode);
+    formatError(error, errorCode, arguments);
+    va_end(arguments);
+
+    fprintf(f, "\"%s\"", error);
+}
+
+// Write the runtime that generated programs share: the frame region, the
+// display, and the record operations from stack.c, followed by the start of main.
+void writeTranspiledHeader(FILE *f, char *inFile, int hasReturn, int hasRegisters) {
+    fprintf(f, "// Generated by Plum from %s. Build with any C compiler, like:\n", inFile);
+    fprintf(f, "// gcc -O2 program.c -o program\n\n");
+    fprintf(f, "#include <stdio.h>\n");
+    fprintf(f, "#include <stdlib.h>\n\n");
+
+    fprintf(f, "// Fields at the start of every activation record in the frame region.\n");
+    fprintf(f, "enum { DEPTH, LOCAL_COUNT, RETURN_VALUE, DYNAMIC_LINK, RETURN_ADDRESS, "
+               "SAVED_DISPLAY, HEADER_SIZE };\n\n");
+
+    fprintf(f, "static int *frames;\n");
+    fprintf(f, "static int top;\n");
+    fprintf(f, "static int capacity;\n");
+    fprintf(f, "static int current = -1;\n");
+    fprintf(f, "static int *display;\n");
+    fprintf(f, "static int displayCapacity;\n\n");
+
+    fprintf(f, "// Runtime functions are inline so that unused ones go unnoticed.\n\n");
+    fprintf(f, "// Stop the program with an error, like the machine does.\n");
+    fprintf(f, "static inline void fail(const char *message) {\n");
+    fprintf(f, "    printf(\"ERROR %%s\\n\", message);\n");
+    fprintf(f, "    exit(0);\n");
+    fprintf(f, "}\n\n");
+
+    fprintf(f, "// Make room for size more ints in the frame region.\n");
+    fprintf(f, "static inline void reserve(int size) {\n");
+    fprintf(f, "    while (top + size > capacity) {\n");
+    fprintf(f, "        capacity = (capacity == 0) ? 1024 : capacity * 2;\n");
+    fprintf(f, "        if ((frames = realloc(frames, sizeof(int) * capacity)) == NULL) {\n");
+    fprintf(f, "            fail(");
+    writeErrorLiteral(f, ERROR_OUT_OF_MEMORY);
+    fprintf(f, ");\n");
+    fprintf(f, "        }\n");
+    fprintf(f, "    }\n");
+    fprintf(f, "}\n\n");
+
+    fprintf(f, "// Push a record for a call made levels out from the current record.\n");
+    fprintf(f, "static inline void push(int levels, int returnAddress) {\n");
+    fprintf(f, "    int i;\n");
+    fprintf(f, "    int depth;\n\n");
+    fprintf(f, "    depth = 0;\n");
+    fprintf(f, "    if (current >= 0) {\n");
+    fprintf(f, "        depth = frames[current + DEPTH] - levels;\n");
+    fprintf(f, "        depth = (depth < 0) ? 1 : depth + 1;\n");
+    fprintf(f, "    }\n\n");
+    fprintf(f, "    reserve(HEADER_SIZE);\n");
+    fprintf(f, "    while (depth >= displayCapacity) {\n");
+    fprintf(f, "        display = realloc(display, sizeof(int) * (displayCapacity + 16));\n");
+    fprintf(f, "        if (display == NULL) {\n");
+    fprintf(f, "            fail(");
+    writeErrorLiteral(f, ERROR_OUT_OF_MEMORY);
+    fprintf(f, ");\n");
+    fprintf(f, "        }\n");
+    fprintf(f, "        for (i = 0; i < 16; i++) {\n");
+    fprintf(f, "            display[displayCapacity + i] = -1;\n");
+    fprintf(f, "        }\n");
+    fprintf(f, "        displayCapacity += 16;\n");
+    fprintf(f, "    }\n\n");
+    fprintf(f, "    frames[top + DEPTH] = depth;\n");
+    fprintf(f, "    frames[top + LOCAL_COUNT] = 0;\n");
+    fprintf(f, "    frames[top + RETURN_VALUE] = 0;\n");
+    fprintf(f, "    frames[top + DYNAMIC_LINK] = current;\n");
+    fprintf(f, "    frames[top + RETURN_ADDRESS] = returnAddress;\n");
+    fprintf(f, "    frames[top + SAVED_DISPLAY] = display[depth];\n");
+    fprintf(f, "    display[depth] = top;\n");
+    fprintf(f, "    current = top;\n");
+    fprintf(f, "    top += HEADER_SIZE;\n");
+    fprintf(f, "}\n\n");
+
+    fprintf(f, "// Pop the current record and return where it was called from.\n");
+    fprintf(f, "static inline int pop(void) {\n");
+    fprintf(f, "    int returnAddress;\n\n");
+    fprintf(f, "    if (frames[current + DYNAMIC_LINK] < 0) {\n");
+    fprintf(f, "        fail(");
+    writeErrorLiteral(f, ERROR_NO_DYNAMIC_PARENT);
+    fprintf(f, ");\n");
+    fprintf(f, "    }\n\n");
+    fprintf(f, "    returnAddress = frames[current + RETURN_ADDRESS];\n");
+    fprintf(f, "    display[frames[current + DEPTH]] = frames[current + SAVED_DISPLAY];\n");
+    fprintf(f, "    top = current;\n");
+    fprintf(f, "    current = frames[current + DYNAMIC_LINK];\n\n");
+    fprintf(f, "    return returnAddress;\n");
+    fprintf(f, "}\n\n");
+
+    fprintf(f, "// Give the current record its locals. A record only gets them once.\n");
+    fprintf(f, "static inline void allocate(int localCount) {\n");
+    fprintf(f, "    int i;\n\n");
+    fprintf(f, "    if (frames[current + LOCAL_COUNT] > 0) {\n");
+    fprintf(f, "        fail(");
+    writeErrorLiteral(f, ERROR_NULL_POINTER);
+    fprintf(f, ");\n");
+    fprintf(f, "    }\n");
+    fprintf(f, "    if (localCount < 1) {\n");
+    fprintf(f, "        return;\n");
+    fprintf(f, "    }\n\n");
+    fprintf(f, "    reserve(localCount);\n");
+    fprintf(f, "    for (i = 0; i < localCount; i++) {\n");
+    fprintf(f, "        frames[top + i] = 0;\n");
+    fprintf(f, "    }\n");
+    fprintf(f, "    frames[current + LOCAL_COUNT] = localCount;\n");
+    fprintf(f, "    top += localCount;\n");
+    fprintf(f, "}\n\n");
+
+    fprintf(f, "// Find the record visible levels out from the current record.\n");
+    fprintf(f, "static inline int record(int levels) {\n");
+    fprintf(f, "    int depth;\n\n");
+    fprintf(f, "    if (levels <= 0) {\n");
+    fprintf(f, "        return current;\n");
+    fprintf(f, "    }\n");
+    fprintf(f, "    depth = frames[current + DEPTH] - levels;\n\n");
+    fprintf(f, "    return display[(depth < 0) ? 0 : depth];\n");
+    fprintf(f, "}\n\n");
+
+    fprintf(f, "// Find local index of a record, failing with message if it doesn't exist.\n");
+    fprintf(f, "static inline int *local(int base, int index, const char *message) {\n");
+    fprintf(f, "    if (index < 0 || index >= frames[base + LOCAL_COUNT]) {\n");
+    fprintf(f, "        fail(message);\n");
+    fprintf(f, "    }\n\n");
+    fprintf(f, "    return &frames[base + HEADER_SIZE + index];\n");
+    fprintf(f, "}\n\n");
+
+    fprintf(f, "int main(void) {\n");
+    if (hasReturn) {
+        fprintf(f, "    int returnAddress;\n");
+    }
+    if (hasRegisters) {
+        fprintf(f, "    int r[%d] = { 0 };\n", REGISTER_COUNT);
+    }
+    if (hasReturn || hasRegisters) {
+        fprintf(f, "\n");
+    }
+    fprintf(f, "    push(0, 0);\n\n");
+}
+
+// Write a variable reference for a LOD or STO instruction.
+void writeTranspiledVariable(FILE *f, Instruction instruction) {
+    char *base;
+    char levels[32];
+
+    if (instruction.LField == 0) {
+        base = "current";
+    }
+    else {
+        snprintf(levels, sizeof(levels), "record(%d)", instruction.LField);
+        base = levels;
+    }
+
+    if (instruction.MField == 0) {
+        fprintf(f, "frames[%s + RETURN_VALUE]", base);
+    }
+    else {
+        fprintf(f, "*local(%s, %d, ", base, instruction.MField - INT_OFFSET);
+        writeErrorLiteral(f, ERROR_LOCAL_INDEX_OUT_OF_BOUNDS, instruction.MField - INT_OFFSET);
+        fprintf(f, ")");
+    }
+}
+
+// Write the C statements for a single instruction. Arithmetic goes through
+// unsigned ints so that overflow wraps the way it does on the machine.
+void writeTranspiledInstruction(FILE *f, Instruction instruction, int index) {
+    int R;
+    int L;
+    int M;
+
+    // Operators for the comparison operations, in opcode order from EQL.
+    static char *comparisons[] = { "==", "!=", "<", "<=", ">", ">=" };
+
+    R = instruction.RField;
+    L = instruction.LField;
+    M = instruction.MField;
+
+    switch (instruction.opCode) {
+        case LIT:
+            fprintf(f, "    r[%d] = %d;\n", R, M);
+            break;
+
+        case RTN:
+            fprintf(f, "    returnAddress = pop();\n");
+            fprintf(f, "    goto returnToCaller;\n");
+            break;
+
+        case LOD:
+            fprintf(f, "    r[%d] = ", R);
+            writeTranspiledVariable(f, instruction);
+            fprintf(f, ";\n");
+            break;
+
+        case STO:
+            fprintf(f, "    ");
+            writeTranspiledVariable(f, instruction);
+            fprintf(f, " = r[%d];\n", R);
+            break;
+
+        case CAL:
+            fprintf(f, "    push(%d, %d);\n", L, index + 1);
+            fprintf(f, "    goto instruction%d;\n", M);
+            break;
+
+        case INC:
+            fprintf(f, "    allocate(%d);\n", M - INT_OFFSET);
+            break;
+
+        case JMP:
+            fprintf(f, "    goto instruction%d;\n", M);
+            break;
+
+        case JPC:
+            fprintf(f, "    if (r[%d] == 0) goto instruction%d;\n", R, M);
+            break;
+
+        case SIO:
+            if (M == CALL_PRINT) {
+                fprintf(f, "    printf(\"%%d\\n\", r[%d]);\n", R);
+            }
+            else if (M == CALL_SCAN) {
+                fprintf(f, "    scanf(\"%%d\", &r[%d]);\n", R);
+            }
+            else {
+                fprintf(f, "    return 0;\n");
+            }
+            break;
+
+        case NEG:
+            fprintf(f, "    r[%d] = (int) (0u - (unsigned int) r[%d]);\n", R, L);
+            break;
+
+        case ADD:
+            fprintf(f, "    r[%d] = (int) ((unsigned int) r[%d] + (unsigned int) r[%d]);\n", R, L, M);
+            break;
+
+        case SUB:
+            fprintf(f, "    r[%d] = (int) ((unsigned int) r[%d] - (unsigned int) r[%d]);\n", R, L, M);
+            break;
+
+        case MUL:
+            fprintf(f, "    r[%d] = (int) ((unsigned int) r[%d] * (unsigned int) r[%d]);\n", R, L, M);
+            break;
+
+        case DIV:
+            fprintf(f, "    if (r[%d] == 0) fail(", M);
+            writeErrorLiteral(f, ERROR_DIVIDE_BY_ZERO);
+            fprintf(f, ");\n");
+            fprintf(f, "    r[%d] = r[%d] / r[%d];\n", R, L, M);
+            break;
+
+        case ODD:
+            fprintf(f, "    r[%d] = ((r[%d] %% 2) != 0);\n", R, R);
+            break;
+
+        case MOD:
+            fprintf(f, "    r[%d] = r[%d] %% r[%d];\n", R, L, M);
+            break;
+
+        case EQL: case NEQ:
+        case LSS: case LEQ:
+        case GTR: case GEQ:
+            fprintf(f, "    r[%d] = (r[%d] %s r[%d]);\n", R, L, comparisons[instruction.opCode - EQL], M);
+            break;
+    }
+}
@@ -0,0 +1,146 @@
+// Part of Plum by Tiger Sachse.
+
+#include <stdio.h>
+#include "machine.h"
+
+// Return the number of register fields an opcode reads or writes: none,
+// only R, or all of R, L, and M.
+int getRegisterCheck(int opCode) {
+    switch (opCode) {
+        case LIT:
+        case LOD:
+        case STO:
+        case JPC:
+        case SIO:
+        case ODD:
+            return 1;
+
+        case NEG: case ADD: case SUB:
+        case MUL: case DIV: case MOD:
+        case EQL: case NEQ:
+        case LSS: case LEQ: case GTR:
+        case GEQ:
+            return 3;
+
+        default:
+            return 0;
+    }
+}
+
+// Check a single instruction. Prints the reason and returns SIGNAL_FAILURE
+// if the instruction could ever fail its static checks at runtime.
+int verifyInstruction(Instruction instruction, int instructionCount) {
+    int registerCheck;
+
+    if (instruction.opCode < LIT || instruction.opCode > GEQ) {
+        printError(ERROR_ILLEGAL_OP_CODE, instruction.opCode);
+
+        return SIGNAL_FAILURE;
+    }
+
+    // System calls must be known, and only print and scan use a register.
+    if (instruction.opCode == SIO) {
+        if (instruction.MField == CALL_KILL) {
+            return SIGNAL_SUCCESS;
+        }
+        else if (instruction.MField != CALL_PRINT && instruction.MField != CALL_SCAN) {
+            printError(ERROR_ILLEGAL_SYSTEM_CALL, instruction.MField);
+
+            return SIGNAL_FAILURE;
+        }
+    }
+
+    registerCheck = getRegisterCheck(instruction.opCode);
+    if (registerCheck >= 1 && invalidRegister(instruction.RField)) {
+        return SIGNAL_FAILURE;
+    }
+    if (registerCheck == 3 &&
+        (invalidRegister(instruction.LField) || invalidRegister(instruction.MField))) {
+
+        return SIGNAL_FAILURE;
+    }
+
+    switch (instruction.opCode) {
+
+        // Jump and call targets must land on an instruction.
+        case JMP:
+        case JPC:
+        case CAL:
+            if (instruction.MField < 0 || instruction.MField >= instructionCount) {
+                printError(ERROR_PROGRAM_COUNTER_OUT_OF_BOUNDS, instruction.MField);
+
+                return SIGNAL_FAILURE;
+            }
+            if (instruction.opCode == CAL && instruction.LField < 0) {
+                printError(ERROR_NO_STATIC_PARENT);
+
+                return SIGNAL_FAILURE;
+            }
+            break;
+
+        // Frames can't have a negative size, and one INC can't ask for more
+        // than the machine is willing to give a single record.
+        case INC:
+            if (instruction.MField < 0) {
+                printError(ERROR_LOCAL_INDEX_OUT_OF_BOUNDS, instruction.MField);
+
+                return SIGNAL_FAILURE;
+            }
+            if (instruction.MField > MAX_FRAME_SIZE) {
+                printError(ERROR_OUT_OF_MEMORY);
+
+                return SIGNAL_FAILURE;
+            }
+            break;
+
+        // Static link walks can't go backwards.
+        case LOD:
+        case STO:
+            if (instruction.LField < 0) {
+                printError(ERROR_NO_STATIC_PARENT);
+
+                return SIGNAL_FAILURE;
+            }
+            break;
+    }
+
+    return SIGNAL_SUCCESS;
+}
+
+// Prove once, before execution, everything about the program that can't change
+// while it runs: opcodes, register indices, system calls, jump targets, and
+// frame sizes.
+// Programs that pass never need those checks again, so the machine skips them.
+int verifyInstructions(Instruction *instructions, int instructionCount) {
+    int i;
+    int lastOpCode;
+
+    if (instructions == NULL || instructionCount <= 0) {
+        printError(ERROR_NULL_POINTER);
+
+        return SIGNAL_FAILURE;
+    }
+
+    for (i = 0; i < instructionCount; i++) {
+        if (verifyInstruction(instructions[i], instructionCount) == SIGNAL_FAILURE) {
+            printError(ERROR_VERIFICATION_FAILED, i);
+
+            return SIGNAL_FAILURE;
+        }
+    }
+
+    // The last instruction must transfer control, otherwise the program counter
+    // could run off the end of the program. Every target and return address is
+    // then guaranteed to be in bounds.
+    lastOpCode = instructions[instructionCount - 1].opCode;
+    if (lastOpCode != JMP && lastOpCode != RTN &&
+        !(lastOpCode == SIO && instructions[instructionCount - 1].MField == CALL_KILL)) {
+
+        printError(ERROR_PROGRAM_COUNTER_OUT_OF_BOUNDS, instructionCount);
+        printError(ERROR_VERIFICATION_FAILED, instructionCount - 1);
+
+        return SIGNAL_FAILURE;
+    }
+
+    return SIGNAL_SUCCESS;
+}
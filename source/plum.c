@@ -1,6 +1,7 @@
 // Part of Plum by Tiger Sachse.
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "plum.h"
 #include "scanner/scanner.h"
@@ -28,6 +29,9 @@ int getMode(char *mode) {
         else if (strcmp(mode, "execute") == 0) {
             return MODE_EXECUTE;
         }
+        else if (strcmp(mode, "transpile") == 0) {
+            return MODE_TRANSPILE;
+        }
         else {
             printError(ERROR_BAD_MODE, mode);
         }
@@ -40,8 +44,10 @@ int getMode(char *mode) {
 int getOptions(int argCount, char **argsVector) {
     int options;
     int argIndex;
+    int optimize;
 
     options = 0;
+    optimize = 1;
 
     // For each argument in the vector, if that argument is supported, fiddle
     // the correct bits in the options int.
@@ -85,6 +91,27 @@ int getOptions(int argCount, char **argsVector) {
         else if (strcmp(argsVector[argIndex], "--trace-registers") == 0) {
             setOption(&options, OPTION_TRACE_REGISTERS);
         }
+        else if (strcmp(argsVector[argIndex], "--print-fusions") == 0) {
+            setOption(&options, OPTION_PRINT_FUSIONS);
+        }
+        else if (strcmp(argsVector[argIndex], "--binary") == 0) {
+            setOption(&options, OPTION_BINARY_BYTECODE);
+        }
+        else if (strcmp(argsVector[argIndex], "--jit") == 0) {
+            setOption(&options, OPTION_JIT);
+        }
+        else if (strcmp(argsVector[argIndex], "--threaded") == 0) {
+            setOption(&options, OPTION_THREADED_DISPATCH);
+        }
+        else if (strcmp(argsVector[argIndex], "--print-opt-stats") == 0) {
+            setOption(&options, OPTION_PRINT_OPT_STATS);
+        }
+        else if (strcmp(argsVector[argIndex], "-O0") == 0) {
+            optimize = 0;
+        }
+        else if (strcmp(argsVector[argIndex], "-O1") == 0) {
+            optimize = 1;
+        }
         else if (strcmp(argsVector[argIndex], "-l") == 0) {
             setOption(&options, OPTION_PRINT_LEXEME_LIST);
         }
@@ -98,6 +125,11 @@ int getOptions(int argCount, char **argsVector) {
         }
     }
 
+    // Optimization is on unless turned off, and the last level given wins.
+    if (optimize) {
+        setOption(&options, OPTION_OPTIMIZE);
+    }
+
     return options;
 }
 
@@ -127,6 +159,46 @@ int getOutFile(int argCount, char **argsVector) {
     return SIGNAL_RECOVERY;
 }
 
+// Scan and compile a source file in memory, without any intermediate files.
+// The bytecode is written to outFile unless it is NULL, then run if requested.
+int processSource(char *sourceFile, char *outFile, int options, int execute) {
+    int returnValue;
+    int instructionCount;
+    LexemeList *lexemes;
+    Instruction *instructions;
+
+    if ((lexemes = createLexemeList()) == NULL) {
+        return SIGNAL_FAILURE;
+    }
+
+    instructions = NULL;
+    if ((returnValue = scanLexemes(sourceFile, lexemes, options)) == SIGNAL_SUCCESS) {
+        instructions = generateInstructions(lexemes, &instructionCount, options);
+        if (instructions == NULL) {
+            returnValue = SIGNAL_FAILURE;
+        }
+    }
+
+    if (returnValue == SIGNAL_SUCCESS && outFile != NULL) {
+        returnValue = writeInstructions(outFile, instructions, instructionCount, options);
+    }
+
+    if (returnValue == SIGNAL_SUCCESS) {
+        if (checkOption(&options, OPTION_PRINT_ASSEMBLY)) {
+            printInstructions(instructions, instructionCount);
+        }
+        if (execute) {
+            returnValue = startMachineWithInstructions(instructions, instructionCount, options);
+        }
+    }
+
+    // Stay memory safe.
+    free(instructions);
+    destroyLexemeList(lexemes);
+
+    return returnValue;
+}
+
 // Main entry point of program.
 int main(int argCount, char **argsVector) {
     int mode;
@@ -183,17 +255,9 @@ int main(int argCount, char **argsVector) {
     }
 
     switch (mode) {
+        // Run mode only writes bytecode when an output file is given.
         case MODE_RUN:
-            if (scanSource(inFile, INTERMEDIATE_FILE, options) == SIGNAL_SUCCESS) {
-                if (compileLexemes(INTERMEDIATE_FILE, outFile, options) == SIGNAL_SUCCESS) {
-                    if (checkOption(&options, OPTION_PRINT_ASSEMBLY)) {
-                        printAssembly(outFile);
-                    }
-                    startMachine(outFile, options);
-                }
-            }
-            
-            remove(INTERMEDIATE_FILE);
+            processSource(inFile, (outFileIndex == SIGNAL_RECOVERY) ? NULL : outFile, options, 1);
             break;
 
         case MODE_SCAN:
@@ -209,15 +273,7 @@ int main(int argCount, char **argsVector) {
             break;
 
         case MODE_COMPILE:
-            if (scanSource(inFile, INTERMEDIATE_FILE, options) == SIGNAL_SUCCESS) {
-                if (compileLexemes(INTERMEDIATE_FILE, outFile, options)) {
-                    if (checkOption(&options, OPTION_PRINT_ASSEMBLY)) {
-                        printAssembly(outFile);
-                    }
-                }
-            }
-            
-            remove(INTERMEDIATE_FILE);
+            processSource(inFile, outFile, options, 0);
             break;
 
         case MODE_EXECUTE:
@@ -226,6 +282,13 @@ int main(int argCount, char **argsVector) {
             }
             startMachine(inFile, options);
             break;
+
+        case MODE_TRANSPILE:
+            if (checkOption(&options, OPTION_PRINT_ASSEMBLY)) {
+                printAssembly(inFile);
+            }
+            transpileInstructions(inFile, outFile);
+            break;
     }
 
     return 0;
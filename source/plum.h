@@ -2,14 +2,30 @@
 #ifndef PLUM_H
 #define PLUM_H
 
+#include <stdio.h>
 #include <limits.h>
+#include <stdarg.h>
 
 #define INT_OFFSET 4
 #define IDENTIFIER_LEN 11
 #define REGISTER_COUNT 16
 #define MAX_ERROR_LENGTH 50
-#define INTERMEDIATE_FILE "plum.tmp"
 #define DEFAULT_OUTPUT_FILE "plum.out"
+#define BYTECODE_MAGIC "PLUM"
+#define BYTECODE_MAGIC_LENGTH 4
+#define BYTECODE_VERSION 1
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_PRIME 16777619u
+#define INITIAL_LEXEME_CAPACITY 1024
+#define LEXEME_WRITE_BUFFER_SIZE 65536
+#define MAX_LEXEME_TEXT_LENGTH (12 + IDENTIFIER_LEN + 2)
+#define LEXEME_MAGIC "PLML"
+#define LEXEME_MAGIC_LENGTH 4
+#define LEXEME_VERSION 1
+#define LEXEME_HEADER_SIZE 20
+#define LEXEME_MAX_RECORD_SIZE 10
+#define INITIAL_INTERN_CAPACITY 256
+#define NO_NAME -1
 
 // Operation codes for each assembly instruction.
 enum Opcodes {
@@ -116,11 +132,14 @@ enum Errors {
     ERROR_FILE_NOT_FOUND,
     ERROR_WRITING_FILE_FAILED,
     ERROR_UNEXPECTED_END_OF_FILE,
+    ERROR_BAD_BYTECODE_FILE,
+    ERROR_BAD_LEXEME_FILE,
 
     // Assembly operation errors.
     ERROR_ILLEGAL_SYSTEM_CALL,
     ERROR_ILLEGAL_OP_CODE,
-    ERROR_DIVIDE_BY_ZERO
+    ERROR_DIVIDE_BY_ZERO,
+    ERROR_VERIFICATION_FAILED
 };
 
 // Available system calls.
@@ -140,7 +159,18 @@ enum Options {
     OPTION_PRINT_LEXEME_TABLE,
     OPTION_PRINT_LEXEME_LIST,
     OPTION_PRINT_SYMBOL_TABLE,
-    OPTION_PRINT_ASSEMBLY
+    OPTION_PRINT_ASSEMBLY,
+    OPTION_THREADED_DISPATCH,
+    OPTION_PRINT_FUSIONS,
+    OPTION_BINARY_BYTECODE,
+    OPTION_JIT,
+    OPTION_OPTIMIZE,
+    OPTION_PRINT_OPT_STATS
+};
+
+// Flags stored in the header of binary bytecode files.
+enum BytecodeFlags {
+    BYTECODE_FLAG_BIG_ENDIAN = 1
 };
 
 // Different modes for the machine.
@@ -149,7 +179,8 @@ enum Modes {
     MODE_SCAN,
     MODE_PARSE,
     MODE_COMPILE,
-    MODE_EXECUTE
+    MODE_EXECUTE,
+    MODE_TRANSPILE
 };
 
 // Instruction struct for each line of PL/0 code.
@@ -160,6 +191,52 @@ typedef struct Instruction {
     int MField;
 } Instruction;
 
+// The text of an interned name.
+typedef struct InternedName {
+    int length;
+    char text[IDENTIFIER_LEN + 1];
+} InternedName;
+
+// Every distinct name in a program, stored once. A name's id is its index in
+// names, so two names are the same exactly when their ids are equal. Ids are
+// found through an open-addressed hash table of slots, kept at most half full.
+typedef struct InternTable {
+    InternedName *names;
+    int count;
+    int capacity;
+    int *slots;
+    int mask;
+} InternTable;
+
+// A single lexeme from the scanner. Identifiers and numbers keep the id of the
+// text they were scanned from in name, and numbers keep their value as well.
+// All other lexemes have NO_NAME.
+typedef struct Lexeme {
+    int token;
+    int value;
+    int name;
+} Lexeme;
+
+// A growable list of lexemes, handed from the scanner to the generator, along
+// with the names its lexemes refer to.
+typedef struct LexemeList {
+    Lexeme *lexemes;
+    int count;
+    int capacity;
+    InternTable *names;
+} LexemeList;
+
+// Header at the start of a binary bytecode file. The instructions follow it
+// directly, as an array of Instruction structs in the byte order of the
+// machine that wrote them.
+typedef struct BytecodeHeader {
+    char magic[BYTECODE_MAGIC_LENGTH];
+    int version;
+    int instructionCount;
+    unsigned int checksum;
+    int flags;
+} BytecodeHeader;
+
 // Utilities functional prototypes.
 void setOption(int*, int);
 int checkOption(int*, int);
@@ -169,10 +246,43 @@ int isAlphabetic(char);
 int isDigit(char);
 int isWhitespace(char);
 void setInstruction(Instruction*, int, int, int, int);
+int isBytecodeFile(char*);
+int isLexemeFile(char*);
+int fileStartsWith(char*, char*, int);
+int getHostBytecodeFlags(void);
+unsigned int checksumInstructions(unsigned int, Instruction*, int);
+unsigned int checksumBytes(unsigned int, unsigned char*, long);
+void encodeWord(unsigned char*, unsigned int);
+unsigned int decodeWord(unsigned char*);
+int encodeVarint(unsigned char*, int);
+int decodeVarint(unsigned char**, unsigned char*, int*);
+int checkBytecodeHeader(BytecodeHeader*, long, char*);
+
+// Intern functional prototypes.
+InternTable *createInternTable(void);
+unsigned int hashName(char*, int);
+int internName(InternTable*, char*, int);
+char *getInternedName(InternTable*, int);
+void destroyInternTable(InternTable*);
+
+// Lexeme functional prototypes.
+LexemeList *createLexemeList(void);
+int appendLexeme(LexemeList*, int, int, int);
+char *getLexemeName(LexemeList*, Lexeme*);
+int loadLexemeName(FILE*, char*);
+LexemeList *loadLexemeList(char*);
+LexemeList *loadLexemeStream(char*);
+int formatLexeme(char*, LexemeList*, Lexeme*);
+int writeLexemeList(LexemeList*, char*, int);
+int writeLexemeStream(LexemeList*, char*);
+void destroyLexemeList(LexemeList*);
 
 // Printer functional prototypes.
+void formatError(char*, int, va_list);
 void printError(int, ...);
 void printAssembly(char*);
+void printInstructions(Instruction*, int);
+void printBytecodeFile(char*, char*);
 void printFile(char*, char*);
 
 #endif
@@ -5,10 +5,9 @@
 #include <stdarg.h>
 #include "plum.h"
 
-// Print error associated with provided errorCode.
-void printError(int errorCode, ...) {
-    va_list arguments;
-    char error[MAX_ERROR_LENGTH];
+// Format the message associated with errorCode into error, which must hold
+// MAX_ERROR_LENGTH characters.
+void formatError(char *error, int errorCode, va_list arguments) {
 
     // All errors in this array map to the appropriate code in
     // an enumeration defined in the plum.h header.
@@ -54,16 +53,16 @@ void printError(int errorCode, ...) {
         "file not found: %s",
         "error writing to file",
         "unexpected end of file",
+        "malformed bytecode file: %s",
+        "malformed lexeme file: %s",
        
         // Assembly operation errors.
         "illegal system call: %d",
         "illegal operation code: %d",
         "attempted to divide by zero",
+        "bytecode rejected at instruction: %d",
     };
 
-    // Initialize the variadic argument list, starting after errorCode.
-    va_start(arguments, errorCode);
-
     switch (errorCode) {
         
         // Errors that must be formatted first. Calls a safe version of sprintf
@@ -87,8 +86,11 @@ void printError(int errorCode, ...) {
         case ERROR_PROGRAM_COUNTER_OUT_OF_BOUNDS:
         case ERROR_FILE_TOO_LONG:
         case ERROR_FILE_NOT_FOUND:
+        case ERROR_BAD_BYTECODE_FILE:
+        case ERROR_BAD_LEXEME_FILE:
         case ERROR_ILLEGAL_SYSTEM_CALL:
         case ERROR_ILLEGAL_OP_CODE:
+        case ERROR_VERIFICATION_FAILED:
             vsnprintf(error, MAX_ERROR_LENGTH, errors[errorCode], arguments);
             break;
 
@@ -96,6 +98,16 @@ void printError(int errorCode, ...) {
         default:
             strcpy(error, errors[errorCode]);
     }
+}
+
+// Print error associated with provided errorCode.
+void printError(int errorCode, ...) {
+    va_list arguments;
+    char error[MAX_ERROR_LENGTH];
+
+    // Initialize the variadic argument list, starting after errorCode.
+    va_start(arguments, errorCode);
+    formatError(error, errorCode, arguments);
 
     // Print the error buffer after formatting.
     printf("ERROR %s\n", error);
@@ -104,12 +116,77 @@ void printError(int errorCode, ...) {
     va_end(arguments);
 }
 
-// Print the assembly file.
+// Print the assembly file. Binary bytecode is printed in the text format.
 void printAssembly(char *assemblyFile) {
-    printFile(assemblyFile, "Assembly:\n---------\n");
+    if (isBytecodeFile(assemblyFile)) {
+        printBytecodeFile(assemblyFile, "Assembly:\n---------\n");
+    }
+    else {
+        printFile(assemblyFile, "Assembly:\n---------\n");
+    }
     printf("\n");
 }
 
+// Print instructions in memory, exactly as printAssembly() would print them
+// from a text bytecode file.
+void printInstructions(Instruction *instructions, int instructionCount) {
+    int i;
+
+    if (instructions == NULL) {
+        printError(ERROR_NULL_POINTER);
+
+        return;
+    }
+
+    printf("Assembly:\n---------\n");
+    for (i = 0; i < instructionCount; i++) {
+        printf("%d %d %d %d\n", instructions[i].opCode,
+                                instructions[i].RField,
+                                instructions[i].LField,
+                                instructions[i].MField);
+    }
+    printf("\n");
+}
+
+// Print the instructions in a binary bytecode file, one per line, exactly as
+// they would appear in a text bytecode file.
+void printBytecodeFile(char *filename, char *header) {
+    FILE *f;
+    long fileSize;
+    Instruction instruction;
+    BytecodeHeader bytecodeHeader;
+
+    if ((f = fopen(filename, "rb")) == NULL) {
+        printError(ERROR_FILE_NOT_FOUND, filename);
+
+        return;
+    }
+
+    // Find the size of the file so that the header can be checked.
+    fseek(f, 0, SEEK_END);
+    fileSize = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    // A short read leaves the header zeroed, which fails the check.
+    memset(&bytecodeHeader, 0, sizeof(BytecodeHeader));
+    fread(&bytecodeHeader, sizeof(BytecodeHeader), 1, f);
+    if (checkBytecodeHeader(&bytecodeHeader, fileSize, filename) == SIGNAL_FAILURE) {
+        fclose(f);
+
+        return;
+    }
+
+    printf("%s", header);
+    while (fread(&instruction, sizeof(Instruction), 1, f) == 1) {
+        printf("%d %d %d %d\n", instruction.opCode,
+                                instruction.RField,
+                                instruction.LField,
+                                instruction.MField);
+    }
+
+    fclose(f);
+}
+
 // Print the contents of the file, as well as a header label.
 void printFile(char *filename, char *header) {
     FILE *f;
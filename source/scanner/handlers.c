@@ -1,28 +1,31 @@
 // Part of Plum by Tiger Sachse.
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "scanner.h"
 
-// Skip past a comment in the source file.
-int skipComment(FILE *f) {
-    char buffer;
+// Return if the character is a letter or digit, according to the class table.
+#define IS_ALPHANUMERIC(character) \
+    (characterClasses[(unsigned char) (character)].class == CLASS_LETTER || \
+     characterClasses[(unsigned char) (character)].class == CLASS_DIGIT)
 
-    if (f == NULL) {
+// Skip past a comment in the source buffer.
+int skipComment(SourceBuffer *source) {
+    if (source == NULL) {
         printError(ERROR_NULL_POINTER);
 
         return SIGNAL_FAILURE;
     }
 
-    // Assumes that the "/*" characters have already been consumed by the
-    // file pointer. Scans through the file until "*/" is found or the end
-    // of the file is reached.
-    while (fscanf(f, "%c", &buffer) != EOF) {
-        if (buffer == '*') {
-            fscanf(f, "%c", &buffer);
-            if (buffer == '/') {
-                return SIGNAL_SUCCESS;
-            }
+    // Assumes that the "/*" characters have already been consumed. Jumps from
+    // '*' to '*' until "*/" is found or the end of the buffer is reached. The
+    // character after every '*' is consumed along with it, so "**/" does not
+    // end a comment.
+    while ((source->cursor = source->kernels->findStar(source->cursor, source->end)) < source->end) {
+        source->cursor++;
+        if (source->cursor < source->end && *source->cursor++ == '/') {
+            return SIGNAL_SUCCESS;
         }
     }
 
@@ -30,198 +33,200 @@ int skipComment(FILE *f) {
 }
 
 // Eat all remaining characters in a bad token.
-void eatCharacters(FILE *fin, int lexemeValue) {
-    char buffer;
-
-    if (fin == NULL) {
+void eatCharacters(SourceBuffer *source) {
+    if (source == NULL) {
         printError(ERROR_NULL_POINTER);
 
         return;
     }
 
-    while (fscanf(fin, "%c", &buffer) != EOF) {
-
-        // Once a non-token character is detected, rewind and break.
-        if (!isAlphanumeric(buffer)) {
-            fseek(fin, -1, SEEK_CUR);
-            break;
-        }
-    }
+    source->cursor = source->kernels->skipAlphanumerics(source->cursor, source->end);
 }
 
-// Check word against all keywords for matches.
-int checkKeywords(FILE *fout, char *word) {
-    int i;
-   
-    KeywordValuePair keywords[] = {
-        { "begin", LEX_BEGIN },
-        { "call", LEX_CALL },
-        { "const", LEX_CONST },
-        { "do", LEX_DO },
-        { "else", LEX_ELSE },
-        { "end", LEX_END },
-        { "if", LEX_IF },
-        { "procedure", LEX_PROCEDURE },
-        { "then", LEX_THEN },
-        { "read", LEX_READ },
-        { "var", LEX_VAR },
-        { "while", LEX_WHILE },
-        { "write", LEX_WRITE }
-    };
-   
-    if (fout == NULL || word == NULL) {
+// Hash values for the characters of keywords. A word's slot in keywordSlots is
+// its length plus the values of its first, second, and last characters, modulo
+// KEYWORD_SLOTS. The values were found by an offline search so that no two
+// keywords share a slot; length with the first and last characters alone can't
+// separate "while" from "write". Characters that appear in no keyword hash to
+// zero, which is harmless because the slot is always compared against the word.
+// Regenerate both tables whenever the keywords change.
+const unsigned char keywordHashValues[CHARACTER_COUNT] = {
+    ['a'] = 9, ['b'] = 8, ['c'] = 1, ['d'] = 15, ['e'] = 8, ['f'] = 1,
+    ['h'] = 15, ['i'] = 10, ['l'] = 13, ['n'] = 14, ['o'] = 7, ['p'] = 5,
+    ['r'] = 1, ['t'] = 12, ['v'] = 8, ['w'] = 6
+};
+
+// Keywords by slot. Empty slots have no keyword and never match.
+const KeywordValuePair keywordSlots[KEYWORD_SLOTS] = {
+    [1] = { "else", 4, LEX_ELSE },
+    [2] = { "while", 5, LEX_WHILE },
+    [3] = { "begin", 5, LEX_BEGIN },
+    [4] = { "write", 5, LEX_WRITE },
+    [5] = { "var", 3, LEX_VAR },
+    [7] = { "procedure", 9, LEX_PROCEDURE },
+    [8] = { "end", 3, LEX_END },
+    [9] = { "const", 5, LEX_CONST },
+    [11] = { "call", 4, LEX_CALL },
+    [12] = { "read", 4, LEX_READ },
+    [13] = { "then", 4, LEX_THEN },
+    [14] = { "if", 2, LEX_IF },
+    [15] = { "do", 2, LEX_DO }
+};
+
+// Check word, of the given length, against the keywords. Only the keyword in
+// the word's hash slot can match, so this is one probe and one compare.
+int checkKeywords(LexemeList *lexemes, char *word, int length) {
+    const KeywordValuePair *slot;
+
+    if (lexemes == NULL || word == NULL) {
         printError(ERROR_NULL_POINTER);
 
         return SIGNAL_FAILURE;
     }
 
-    // If any of the keywords match the word, return success.
-    for (i = 0; i < KEYWORDS; i++) {
-        if (strcmp(word, keywords[i].keyword) == 0) {
-            fprintf(fout, "%d ", keywords[i].value);
+    if (length < KEYWORD_MIN_LEN || length > KEYWORD_MAX_LEN) {
+        return SIGNAL_FAILURE;
+    }
 
-            return SIGNAL_SUCCESS;
-        }
+    slot = &keywordSlots[(length +
+                          keywordHashValues[(unsigned char) word[0]] +
+                          keywordHashValues[(unsigned char) word[1]] +
+                          keywordHashValues[(unsigned char) word[length - 1]]) % KEYWORD_SLOTS];
+
+    // If the keyword in the slot matches the word, return success.
+    if (slot->length == length && memcmp(word, slot->keyword, length) == 0) {
+        return appendLexeme(lexemes, slot->value, 0, NO_NAME);
     }
-   
+
     return SIGNAL_FAILURE;
 }
 
-// Send a directly-mapped symbol's lexeme value to the output file.
-int handleDirectMappedSymbol(FILE *fout, int lexemeValue) {
-    if (fout == NULL) {
+// Add a directly-mapped symbol's lexeme value to the lexeme list.
+int handleDirectMappedSymbol(LexemeList *lexemes, int lexemeValue) {
+    if (lexemes == NULL) {
         printError(ERROR_NULL_POINTER);
         
         return SIGNAL_FAILURE;
     }
 
-    fprintf(fout, "%d ", lexemeValue);
-    
-    return SIGNAL_SUCCESS;
+    return appendLexeme(lexemes, lexemeValue, 0, NO_NAME);
 }
 
-// Print appropriate lexeme value to output file, based on presence of pair
-// in the input file.
-int handlePair(FILE *fin, FILE *fout, SymbolSymbolPair pair) {
+// Add the appropriate lexeme value to the lexeme list, based on presence of
+// pair in the source buffer. The lead character has already been consumed.
+int handlePair(SourceBuffer *source, LexemeList *lexemes, const SymbolSymbolPair *pair) {
     int i;
-    char buffer;
     
-    if (fin == NULL || fout == NULL) {
+    if (source == NULL || lexemes == NULL || pair == NULL) {
         printError(ERROR_NULL_POINTER);
         
         return SIGNAL_FAILURE;
     }
     
-    if (fscanf(fin, "%c", &buffer) != EOF) {
+    // Check all expected follow characters for pairs.
+    if (source->cursor < source->end) {
+        for (i = 0; i < pair->pairs; i++) {
+            if (*source->cursor == pair->follows[i]) {
+                source->cursor++;
+
+                if (pair->pairValues[i] == LEX_COMMENT) {
+                    skipComment(source);
 
-        // Check all expected follow characters for pairs.
-        for (i = 0; i < pair.pairs; i++) {
-            if (buffer == pair.follows[i]) {
-                if (pair.pairValues[i] == LEX_COMMENT) {
-                    skipComment(fin);
+                    return SIGNAL_SUCCESS;
                 }
                 else {
-                    fprintf(fout, "%d ", pair.pairValues[i]);
+                    return appendLexeme(lexemes, pair->pairValues[i], 0, NO_NAME);
                 }
-
-                return SIGNAL_SUCCESS;
             }
         }
-    
-        // Else the next character was something else. Rewind the file pointer.
-        fseek(fin, -1, SEEK_CUR);
     }
 
     // If the solo value indicates the symbol is unknown, throw an
-    // error, else print it to the output file.
-    if (pair.soloValue == LEX_UNKNOWN) {
-        printError(ERROR_UNKNOWN_CHARACTER, pair.lead);
+    // error, else add it to the lexeme list.
+    if (pair->soloValue == LEX_UNKNOWN) {
+        printError(ERROR_UNKNOWN_CHARACTER, pair->lead);
 
         return SIGNAL_FAILURE;
     }
     else {
-        fprintf(fout, "%d ", pair.soloValue);
-    
-        return SIGNAL_SUCCESS;
+        return appendLexeme(lexemes, pair->soloValue, 0, NO_NAME);
     }
 }
 
-// Handle long tokens like words and numbers in the input file.
-int handleLongToken(FILE *fin, FILE *fout, char first, int lexemeValue, int len) {
-    int index;
-    char buffer;
+// Handle long tokens like words and numbers in the source buffer, starting at
+// the cursor.
+int handleLongToken(SourceBuffer *source, LexemeList *lexemes, int lexemeValue, int len) {
+    int name;
+    int length;
+    char *start;
+    char *limit;
     char token[len + 1];
     
-    if (fin == NULL || fout == NULL) {
+    if (source == NULL || lexemes == NULL) {
         printError(ERROR_NULL_POINTER);
         
         return SIGNAL_FAILURE;
     }
 
-    index = 0;
-    token[index++] = first;
-
-    // Eat up more characters!
-    while (index < len && fscanf(fin, "%c", &buffer) != EOF) {
-       
-        // If we are building an identifier and the buffer is alphanumeric
-        // or if we are building a number and the buffer is a digit,
-        // add to the token array.
-        if ((lexemeValue == LEX_IDENTIFIER && isAlphanumeric(buffer)) ||
-            (lexemeValue == LEX_NUMBER && isDigit(buffer))) {
-            
-            token[index++] = buffer;
-        }
-       
-        // Else rewind the file because the end of the
-        // token has been reached.
-        else {
-            fseek(fin, -1, SEEK_CUR);
-            break;
-        }
+    // Eat up to len characters. Identifiers are letters and digits, and
+    // numbers are digits only.
+    start = source->cursor;
+    limit = (source->end - start > len) ? start + len : source->end;
+    if (lexemeValue == LEX_IDENTIFIER) {
+        source->cursor = source->kernels->skipAlphanumerics(start + 1, limit);
+    }
+    else {
+        source->cursor = source->kernels->skipDigits(start + 1, limit);
     }
 
+    // Make the token a bonafide string.
+    length = source->cursor - start;
+    memcpy(token, start, length);
+    token[length] = '\0';
+
     // Check the next character.
-    if (fscanf(fin, "%c", &buffer) != EOF) {
-        fseek(fin, -1, SEEK_CUR);
-        
-        if (isAlphanumeric(buffer)) {
-            eatCharacters(fin, lexemeValue);
-            token[index] = '\0';
-
-            // If we were building a number and it's followed by a letter,
-            // this is actually an identifier with digits at the start.
-            if (lexemeValue == LEX_NUMBER && isAlphabetic(buffer)) {
-                printError(ERROR_ILLEGAL_IDENTIFIER, token);
-            }
-       
-            // Else we either have a number that's too long or an
-            // identifier that's too long.
-            else if (lexemeValue == LEX_NUMBER) {
-                printError(ERROR_NUMBER_TOO_LARGE, token);
-            }
-            else {
-                printError(ERROR_IDENTIFIER_TOO_LARGE, token);
-            }
+    if (source->cursor < source->end && IS_ALPHANUMERIC(*source->cursor)) {
 
-            // Explode.
-            return SIGNAL_FAILURE;
+        // If we were building a number and it's followed by a letter,
+        // this is actually an identifier with digits at the start.
+        if (lexemeValue == LEX_NUMBER &&
+            characterClasses[(unsigned char) *source->cursor].class == CLASS_LETTER) {
+
+            printError(ERROR_ILLEGAL_IDENTIFIER, token);
         }
-    }
+   
+        // Else we either have a number that's too long or an
+        // identifier that's too long.
+        else if (lexemeValue == LEX_NUMBER) {
+            printError(ERROR_NUMBER_TOO_LARGE, token);
+        }
+        else {
+            printError(ERROR_IDENTIFIER_TOO_LARGE, token);
+        }
+        eatCharacters(source);
 
-    // Make the token a bonafide string.
-    token[index] = '\0';
+        // Explode.
+        return SIGNAL_FAILURE;
+    }
 
     if (lexemeValue == LEX_IDENTIFIER) {
 
         // If the word doesn't match any keywords,
-        // print into the output file as an identifier.
-        if (checkKeywords(fout, token) == SIGNAL_FAILURE) {
-            fprintf(fout, "%d %s ", LEX_IDENTIFIER, token);
+        // add it to the lexeme list as an identifier.
+        if (checkKeywords(lexemes, token, length) == SIGNAL_FAILURE) {
+            if ((name = internName(lexemes->names, token, length)) == SIGNAL_FAILURE) {
+                return SIGNAL_FAILURE;
+            }
+
+            return appendLexeme(lexemes, LEX_IDENTIFIER, 0, name);
         }
     }
     else if (lexemeValue == LEX_NUMBER){
-        fprintf(fout, "%d %s ", LEX_NUMBER, token);
+        if ((name = internName(lexemes->names, token, length)) == SIGNAL_FAILURE) {
+            return SIGNAL_FAILURE;
+        }
+
+        return appendLexeme(lexemes, LEX_NUMBER, atoi(token), name);
     }
 
     return SIGNAL_SUCCESS;
@@ -0,0 +1,211 @@
+// Part of Plum by Tiger Sachse.
+
+#include "scanner.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define VECTOR_KERNELS
+#endif
+
+// Skip whitespace from cursor, stopping at end. Returns the first character
+// that isn't whitespace, or end.
+char *skipWhitespaceScalar(char *cursor, char *end) {
+    while (cursor < end && characterClasses[(unsigned char) *cursor].class == CLASS_WHITESPACE) {
+        cursor++;
+    }
+
+    return cursor;
+}
+
+// Skip letters and digits from cursor, stopping at end.
+char *skipAlphanumericsScalar(char *cursor, char *end) {
+    while (cursor < end && (characterClasses[(unsigned char) *cursor].class == CLASS_LETTER ||
+                            characterClasses[(unsigned char) *cursor].class == CLASS_DIGIT)) {
+        cursor++;
+    }
+
+    return cursor;
+}
+
+// Skip digits from cursor, stopping at end.
+char *skipDigitsScalar(char *cursor, char *end) {
+    while (cursor < end && characterClasses[(unsigned char) *cursor].class == CLASS_DIGIT) {
+        cursor++;
+    }
+
+    return cursor;
+}
+
+// Find the first '*' from cursor, or end if there isn't one.
+char *findStarScalar(char *cursor, char *end) {
+    while (cursor < end && *cursor != '*') {
+        cursor++;
+    }
+
+    return cursor;
+}
+
+#ifdef VECTOR_KERNELS
+
+// Masks of the characters in a vector that fall in [low, high], for unsigned
+// characters. Subtracting low moves the range to [0, high - low], and a
+// character is in range when the unsigned minimum leaves it unchanged.
+#define RANGE_SSE2(characters, low, high) \
+    _mm_cmpeq_epi8(_mm_min_epu8(_mm_sub_epi8(characters, _mm_set1_epi8(low)), \
+                                _mm_set1_epi8((high) - (low))), \
+                   _mm_sub_epi8(characters, _mm_set1_epi8(low)))
+#define RANGE_AVX2(characters, low, high) \
+    _mm256_cmpeq_epi8(_mm256_min_epu8(_mm256_sub_epi8(characters, _mm256_set1_epi8(low)), \
+                                      _mm256_set1_epi8((high) - (low))), \
+                      _mm256_sub_epi8(characters, _mm256_set1_epi8(low)))
+
+// Whitespace is a space or anything from '\t' to '\r'.
+#define WHITESPACE_SSE2(characters) \
+    _mm_or_si128(_mm_cmpeq_epi8(characters, _mm_set1_epi8(' ')), RANGE_SSE2(characters, '\t', '\r'))
+#define WHITESPACE_AVX2(characters) \
+    _mm256_or_si256(_mm256_cmpeq_epi8(characters, _mm256_set1_epi8(' ')), \
+                    RANGE_AVX2(characters, '\t', '\r'))
+
+// Setting the 0x20 bit folds upper case letters onto lower case ones.
+#define ALPHANUMERIC_SSE2(characters) \
+    _mm_or_si128(RANGE_SSE2(_mm_or_si128(characters, _mm_set1_epi8(0x20)), 'a', 'z'), \
+                 RANGE_SSE2(characters, '0', '9'))
+#define ALPHANUMERIC_AVX2(characters) \
+    _mm256_or_si256(RANGE_AVX2(_mm256_or_si256(characters, _mm256_set1_epi8(0x20)), 'a', 'z'), \
+                    RANGE_AVX2(characters, '0', '9'))
+
+// Defines a kernel that skips characters matching a class, a whole vector at a
+// time while one fits before end, then finishes with the scalar kernel. The
+// first zero bit of the match mask is the first character that doesn't match.
+#define SKIP_KERNEL(name, width, type, load, matches, movemask, attributes, scalar) \
+    attributes char *name(char *cursor, char *end) { \
+        type characters; \
+        unsigned int mask; \
+        \
+        while (end - cursor >= (width)) { \
+            characters = load((type*) cursor); \
+            mask = ~(unsigned int) movemask(matches(characters)) & \
+                   (((width) == 32) ? 0xFFFFFFFFu : 0xFFFFu); \
+            if (mask != 0) { \
+                return cursor + __builtin_ctz(mask); \
+            } \
+            cursor += (width); \
+        } \
+        \
+        return scalar(cursor, end); \
+    }
+
+// Defines a kernel that finds the first '*', a whole vector at a time.
+#define STAR_KERNEL(name, width, type, load, compare, set, movemask, attributes) \
+    attributes char *name(char *cursor, char *end) { \
+        unsigned int mask; \
+        \
+        while (end - cursor >= (width)) { \
+            mask = movemask(compare(load((type*) cursor), set('*'))); \
+            if (mask != 0) { \
+                return cursor + __builtin_ctz(mask); \
+            } \
+            cursor += (width); \
+        } \
+        \
+        return findStarScalar(cursor, end); \
+    }
+
+#define DIGITS_SSE2(characters) RANGE_SSE2(characters, '0', '9')
+#define DIGITS_AVX2(characters) RANGE_AVX2(characters, '0', '9')
+#define SSE2 __attribute__((target("sse2")))
+#define AVX2 __attribute__((target("avx2")))
+
+SKIP_KERNEL(skipWhitespaceSSE2, 16, __m128i, _mm_loadu_si128, WHITESPACE_SSE2,
+            _mm_movemask_epi8, SSE2, skipWhitespaceScalar)
+SKIP_KERNEL(skipAlphanumericsSSE2, 16, __m128i, _mm_loadu_si128, ALPHANUMERIC_SSE2,
+            _mm_movemask_epi8, SSE2, skipAlphanumericsScalar)
+SKIP_KERNEL(skipDigitsSSE2, 16, __m128i, _mm_loadu_si128, DIGITS_SSE2,
+            _mm_movemask_epi8, SSE2, skipDigitsScalar)
+STAR_KERNEL(findStarSSE2, 16, __m128i, _mm_loadu_si128, _mm_cmpeq_epi8, _mm_set1_epi8,
+            _mm_movemask_epi8, SSE2)
+
+SKIP_KERNEL(skipWhitespaceAVX2, 32, __m256i, _mm256_loadu_si256, WHITESPACE_AVX2,
+            _mm256_movemask_epi8, AVX2, skipWhitespaceScalar)
+SKIP_KERNEL(skipAlphanumericsAVX2, 32, __m256i, _mm256_loadu_si256, ALPHANUMERIC_AVX2,
+            _mm256_movemask_epi8, AVX2, skipAlphanumericsScalar)
+SKIP_KERNEL(skipDigitsAVX2, 32, __m256i, _mm256_loadu_si256, DIGITS_AVX2,
+            _mm256_movemask_epi8, AVX2, skipDigitsScalar)
+STAR_KERNEL(findStarAVX2, 32, __m256i, _mm256_loadu_si256, _mm256_cmpeq_epi8, _mm256_set1_epi8,
+            _mm256_movemask_epi8, AVX2)
+
+// Ask the processor, through CPUID, whether it has AVX2 and whether the
+// operating system saves the AVX registers (XCR0 bits 1 and 2).
+int hasAVX2(void) {
+    unsigned int eax;
+    unsigned int ebx;
+    unsigned int ecx;
+    unsigned int edx;
+    unsigned int xcr0;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_OSXSAVE) || !(ecx & bit_AVX)) {
+        return SIGNAL_FALSE;
+    }
+
+    __asm__ ("xgetbv" : "=a" (xcr0), "=d" (edx) : "c" (0));
+    if ((xcr0 & 6) != 6) {
+        return SIGNAL_FALSE;
+    }
+
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        return SIGNAL_FALSE;
+    }
+
+    return (ebx & bit_AVX2) ? SIGNAL_TRUE : SIGNAL_FALSE;
+}
+
+// Ask the processor, through CPUID, whether it has SSE2.
+int hasSSE2(void) {
+    unsigned int eax;
+    unsigned int ebx;
+    unsigned int ecx;
+    unsigned int edx;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return SIGNAL_FALSE;
+    }
+
+    return (edx & bit_SSE2) ? SIGNAL_TRUE : SIGNAL_FALSE;
+}
+
+#endif
+
+// Choose the widest set of scanner kernels this processor supports.
+const ScannerKernels *selectScannerKernels(void) {
+    static const ScannerKernels scalar = {
+        skipWhitespaceScalar,
+        skipAlphanumericsScalar,
+        skipDigitsScalar,
+        findStarScalar
+    };
+
+#ifdef VECTOR_KERNELS
+    static const ScannerKernels sse2 = {
+        skipWhitespaceSSE2,
+        skipAlphanumericsSSE2,
+        skipDigitsSSE2,
+        findStarSSE2
+    };
+    static const ScannerKernels avx2 = {
+        skipWhitespaceAVX2,
+        skipAlphanumericsAVX2,
+        skipDigitsAVX2,
+        findStarAVX2
+    };
+
+    if (hasAVX2()) {
+        return &avx2;
+    }
+    if (hasSSE2()) {
+        return &sse2;
+    }
+#endif
+
+    return &scalar;
+}
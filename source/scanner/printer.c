@@ -9,9 +9,25 @@ void printSource(char *filename) {
     printf("\n");
 }
 
-// Call printFile for a lexeme file.
-void printLexemeList(char *filename) {
-    printFile(filename, "Lexeme List:\n------------\n");
+// Print a lexeme list exactly as it is written to a lexeme file.
+void printLexemeList(LexemeList *lexemes) {
+    int i;
+
+    if (lexemes == NULL) {
+        printError(ERROR_NULL_POINTER);
+
+        return;
+    }
+
+    printf("Lexeme List:\n------------\n");
+    for (i = 0; i < lexemes->count; i++) {
+        if (lexemes->lexemes[i].token == LEX_IDENTIFIER || lexemes->lexemes[i].token == LEX_NUMBER) {
+            printf("%d %s ", lexemes->lexemes[i].token, getLexemeName(lexemes, &lexemes->lexemes[i]));
+        }
+        else {
+            printf("%d ", lexemes->lexemes[i].token);
+        }
+    }
     printf("\n\n");
 }
 
@@ -20,15 +36,14 @@ void printLexemeTableLine(char *lexeme, int lexemeValue) {
     printf("%12s | %d\n", lexeme, lexemeValue); // magic number
 }
 
-// Print entire lexeme table from lexeme file.
-void printLexemeTable(char *filename) {
-    FILE *f;
-    int buffer;
-    char word[IDENTIFIER_LEN + 1];
+// Print entire lexeme table from a lexeme list.
+void printLexemeTable(LexemeList *lexemes) {
+    int i;
+    int token;
 
     // These lexemes directly map to the LexemeValues enumeration
     // defined in the analyzer header (with an offset of four).
-    char *lexemes[] = {
+    char *symbols[] = {
         "+", "-", "*", "/", "odd", "=", "<>", "<",
         "<=", ">", ">=", "(", ")", ",", ";", ".", ":=",
         "begin", "end", "if", "then", "while", "do",
@@ -36,9 +51,9 @@ void printLexemeTable(char *filename) {
         "write", "read", "else",
     };
 
-    if ((f = fopen(filename, "r")) == NULL) {
-        printError(ERROR_FILE_NOT_FOUND, filename);
-        
+    if (lexemes == NULL) {
+        printError(ERROR_NULL_POINTER);
+
         return;
     }
 
@@ -46,24 +61,21 @@ void printLexemeTable(char *filename) {
     printf("     :Lexeme | Value:\n");
     printf("     ----------------\n");
 
-    // For each integer in the file, print the relevant symbol and lexeme value.
-    while (fscanf(f, "%d", &buffer) != EOF) {
+    // For each lexeme in the list, print the relevant symbol and lexeme value.
+    for (i = 0; i < lexemes->count; i++) {
+        token = lexemes->lexemes[i].token;
 
-        // If the buffer is for an identifier or number, read the next
-        // string in the file and then print.
-        if (buffer == LEX_IDENTIFIER || buffer == LEX_NUMBER) {
-            fscanf(f, "%12s", word); // magic number
-            printLexemeTableLine(word, buffer);
+        // Identifiers and numbers print the text they were scanned from.
+        if (token == LEX_IDENTIFIER || token == LEX_NUMBER) {
+            printLexemeTableLine(getLexemeName(lexemes, &lexemes->lexemes[i]), token);
         }
 
-        // Else print the lexeme from the lexemes array, with an offset of
+        // Else print the lexeme from the symbols array, with an offset of
         // four to account for the first four values in the enumeration not
         // being included.
         else {
-            printLexemeTableLine(lexemes[buffer - 4], buffer); // magic number
+            printLexemeTableLine(symbols[token - 4], token); // magic number
         }
     }
     printf("\n");
-
-    fclose(f);
 }
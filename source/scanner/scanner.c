@@ -1,87 +1,123 @@
 // Part of Plum by Tiger Sachse.
 
 #include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "scanner.h"
 
+// The class of every character. Whitespace is everything fscanf() skips, and
+// anything not listed here is unknown.
+const CharacterClass characterClasses[CHARACTER_COUNT] = {
+    [' '] = { CLASS_WHITESPACE, 0 },
+    ['\t'] = { CLASS_WHITESPACE, 0 },
+    ['\n'] = { CLASS_WHITESPACE, 0 },
+    ['\v'] = { CLASS_WHITESPACE, 0 },
+    ['\f'] = { CLASS_WHITESPACE, 0 },
+    ['\r'] = { CLASS_WHITESPACE, 0 },
+    ['a' ... 'z'] = { CLASS_LETTER, 0 },
+    ['A' ... 'Z'] = { CLASS_LETTER, 0 },
+    ['0' ... '9'] = { CLASS_DIGIT, 0 },
+    ['+'] = { CLASS_SYMBOL, LEX_PLUS },
+    ['-'] = { CLASS_SYMBOL, LEX_MINUS },
+    ['*'] = { CLASS_SYMBOL, LEX_MULTIPLY },
+    ['('] = { CLASS_SYMBOL, LEX_LEFT_PARENTHESIS },
+    [')'] = { CLASS_SYMBOL, LEX_RIGHT_PARENTHESIS },
+    [','] = { CLASS_SYMBOL, LEX_COMMA },
+    ['.'] = { CLASS_SYMBOL, LEX_PERIOD },
+    [';'] = { CLASS_SYMBOL, LEX_SEMICOLON },
+    ['='] = { CLASS_SYMBOL, LEX_EQUAL },
+    ['<'] = { CLASS_PAIR, 0 },
+    ['>'] = { CLASS_PAIR, 1 },
+    [':'] = { CLASS_PAIR, 2 },
+    ['/'] = { CLASS_PAIR, 3 }
+};
+
+// Symbols that may be followed by a second character, indexed by the value
+// of their character class.
+const SymbolSymbolPair pairedSymbols[] = {
+    { '<', { '>', '=' }, LEX_LESS, { LEX_NOT_EQUAL, LEX_LESS_EQUAL }, 2 },
+    { '>', { '=' }, LEX_GREATER, { LEX_GREATER_EQUAL }, 1 },
+    { ':', { '=' }, LEX_UNKNOWN, { LEX_BECOME }, 1 },
+    { '/', { '*' }, LEX_SLASH, { LEX_COMMENT }, 1 }
+};
+
 // Convert the input file into lexeme values and export to an output file.
 int scanSource(char *sourceFile, char *outFile, int options) {
-    int i;
-    FILE *fin;
-    FILE *fout;
-    char buffer;
-    int singleStatus;
     int returnStatus;
+    LexemeList *lexemes;
 
-    const int pairedSymbolsCount = 4;
-    const int directMappedSymbolsCount = 9;
-
-    SymbolValuePair directMappedSymbols[] = {
-        { '+', LEX_PLUS },
-        { '-', LEX_MINUS },
-        { '*', LEX_MULTIPLY },
-        { '(', LEX_LEFT_PARENTHESIS },
-        { ')', LEX_RIGHT_PARENTHESIS },
-        { ',', LEX_COMMA },
-        { '.', LEX_PERIOD },
-        { ';', LEX_SEMICOLON },
-        { '=', LEX_EQUAL }
-    };
-
-    SymbolSymbolPair pairedSymbols[] = {
-        { '<', { '>', '=' }, LEX_LESS, { LEX_NOT_EQUAL, LEX_LESS_EQUAL }, 2 },
-        { '>', { '=' }, LEX_GREATER, { LEX_GREATER_EQUAL }, 1 },
-        { ':', { '=' }, LEX_UNKNOWN, { LEX_BECOME }, 1 },
-        { '/', { '*' }, LEX_SLASH, { LEX_COMMENT }, 1 }
-    };
-        
-    if ((fin = fopen(sourceFile, "r")) == NULL) {
-        printError(ERROR_FILE_NOT_FOUND, sourceFile);
-
+    if ((lexemes = createLexemeList()) == NULL) {
         return SIGNAL_FAILURE;
     }
 
-    if ((fout = fopen(outFile, "w")) == NULL) {
-        printError(ERROR_FILE_NOT_FOUND, outFile);
-        fclose(fin);
+    // Whatever was scanned is written out, even if scanning failed part way.
+    returnStatus = scanLexemes(sourceFile, lexemes, options);
+    if (writeLexemeList(lexemes, outFile, options) == SIGNAL_FAILURE) {
+        returnStatus = SIGNAL_FAILURE;
+    }
+
+    destroyLexemeList(lexemes);
 
+    return returnStatus;
+}
+
+// Convert the input file into lexeme values and append them to lexemes. The
+// file is mapped into memory and scanned as a DFA over its bytes: the class of
+// the current character picks the handler, and each handler consumes the
+// rest of its token with the scanner kernels.
+int scanLexemes(char *sourceFile, LexemeList *lexemes, int options) {
+    char character;
+    int singleStatus;
+    int returnStatus;
+    SourceBuffer source;
+    const CharacterClass *class;
+
+    if (mapSource(sourceFile, &source) == SIGNAL_FAILURE) {
         return SIGNAL_FAILURE;
     }
 
+    // Runs of whitespace, comments, and long tokens are skipped with the
+    // widest vector instructions the processor has.
+    source.kernels = selectScannerKernels();
+
     returnStatus = SIGNAL_SUCCESS;
 
-    // Read through the characters in a file and match them to their
+    // Read through the characters in the buffer and match them to their
     // appropriate lexeme values using handler functions.
-    while (fscanf(fin, " %c", &buffer) != EOF) {
-        if (isAlphabetic(buffer)) {
-            singleStatus = handleLongToken(fin, fout, buffer, LEX_IDENTIFIER, IDENTIFIER_LEN); 
-        }
-        else if (isDigit(buffer)) {
-            singleStatus = handleLongToken(fin, fout, buffer, LEX_NUMBER, NUMBER_LEN); 
-        }
-        else {
-            for (i = 0; i < directMappedSymbolsCount; i++) {
-                if (buffer == directMappedSymbols[i].symbol) {
-                    singleStatus = handleDirectMappedSymbol(fout, directMappedSymbols[i].value);
-                    break;
-                }
-            }
+    while (source.cursor < source.end) {
+        character = *source.cursor;
+        class = &characterClasses[(unsigned char) character];
 
-            // If the loop didn't terminate early (i.e. the buffer was not
-            // a direct-mapped symbol), loop through the paired symbols.
-            if (i == directMappedSymbolsCount) {
-                for (i = 0; i < pairedSymbolsCount; i++) {
-                    if (buffer == pairedSymbols[i].lead) {
-                        singleStatus = handlePair(fin, fout, pairedSymbols[i]);
-                        break;
-                    } 
-                }
-
-                // If this loop also didn't terminate early, give up.
-                if (i == pairedSymbolsCount) {
-                   printError(ERROR_UNKNOWN_CHARACTER, buffer);
-                   singleStatus = SIGNAL_FAILURE;
-                }
-            }
+        switch (class->class) {
+            case CLASS_WHITESPACE:
+                source.cursor = source.kernels->skipWhitespace(source.cursor, source.end);
+                continue;
+
+            case CLASS_LETTER:
+                singleStatus = handleLongToken(&source, lexemes, LEX_IDENTIFIER, IDENTIFIER_LEN);
+                break;
+
+            case CLASS_DIGIT:
+                singleStatus = handleLongToken(&source, lexemes, LEX_NUMBER, NUMBER_LEN);
+                break;
+
+            case CLASS_SYMBOL:
+                source.cursor++;
+                singleStatus = handleDirectMappedSymbol(lexemes, class->value);
+                break;
+
+            case CLASS_PAIR:
+                source.cursor++;
+                singleStatus = handlePair(&source, lexemes, &pairedSymbols[class->value]);
+                break;
+
+            // Anything else is unknown, so give up.
+            default:
+                source.cursor++;
+                printError(ERROR_UNKNOWN_CHARACTER, character);
+                singleStatus = SIGNAL_FAILURE;
         }
 
         // Set persistent returnStatus to failure if a handler call failed.
@@ -95,22 +131,77 @@ int scanSource(char *sourceFile, char *outFile, int options) {
         }
     }
 
-    // Don't leave files open like a lunatic.
-    fclose(fin);
-    fclose(fout);
+    // Don't leave files mapped like a lunatic.
+    unmapSource(&source);
 
     if (returnStatus != SIGNAL_FAILURE || checkOption(&options, OPTION_SKIP_ERRORS)) {
         if (checkOption(&options, OPTION_PRINT_SOURCE)) {
             printSource(sourceFile);
         }
         if (checkOption(&options, OPTION_PRINT_LEXEME_TABLE)) {
-            printLexemeTable(outFile);
+            printLexemeTable(lexemes);
         }
         if (checkOption(&options, OPTION_PRINT_LEXEME_LIST)) {
-            printLexemeList(outFile);
+            printLexemeList(lexemes);
         }
     }
 
     // If OPTION_SKIP_ERRORS is on, pretend like everything went fine.
     return checkOption(&options, OPTION_SKIP_ERRORS) ? SIGNAL_SUCCESS : returnStatus;
 }
+
+// Map the whole source file into memory, read only. Empty files have nothing
+// to map, so they get an empty buffer.
+int mapSource(char *sourceFile, SourceBuffer *source) {
+    int descriptor;
+    struct stat status;
+
+    if (sourceFile == NULL || source == NULL) {
+        printError(ERROR_NULL_POINTER);
+
+        return SIGNAL_FAILURE;
+    }
+
+    if ((descriptor = open(sourceFile, O_RDONLY)) < 0) {
+        printError(ERROR_FILE_NOT_FOUND, sourceFile);
+
+        return SIGNAL_FAILURE;
+    }
+
+    if (fstat(descriptor, &status) != 0) {
+        close(descriptor);
+        printError(ERROR_FILE_NOT_FOUND, sourceFile);
+
+        return SIGNAL_FAILURE;
+    }
+
+    source->start = NULL;
+    source->length = status.st_size;
+    if (source->length > 0) {
+
+        // The mapping stays valid after the descriptor is closed.
+        source->start = mmap(NULL, source->length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if (source->start == MAP_FAILED) {
+            close(descriptor);
+            printError(ERROR_OUT_OF_MEMORY);
+
+            return SIGNAL_FAILURE;
+        }
+    }
+    close(descriptor);
+
+    source->cursor = source->start;
+    source->end = (source->start == NULL) ? NULL : source->start + source->length;
+
+    return SIGNAL_SUCCESS;
+}
+
+// Unmap a source file mapped by mapSource().
+void unmapSource(SourceBuffer *source) {
+    if (source == NULL || source->start == NULL) {
+        return;
+    }
+
+    munmap(source->start, source->length);
+    source->start = NULL;
+}
@@ -1,24 +1,34 @@
 // Part of Plum by Tiger Sachse.
 
 #include <stdio.h>
+#include <stddef.h>
 #include "../plum.h"
 
 // Constants.
 #define KEYWORDS 13
+#define KEYWORD_SLOTS 16
+#define KEYWORD_MIN_LEN 2
+#define KEYWORD_MAX_LEN 9
 #define NUMBER_LEN 5
+#define CHARACTER_COUNT 256
+
+// Classes of characters in source code. Every character belongs to exactly one.
+enum CharacterClasses {
+    CLASS_UNKNOWN,
+    CLASS_WHITESPACE,
+    CLASS_LETTER,
+    CLASS_DIGIT,
+    CLASS_SYMBOL,
+    CLASS_PAIR
+};
 
 // Map keywords and their values.
 typedef struct KeywordValuePair {
     char *keyword;
+    int length;
     int value;
 } KeywordValuePair;
 
-// Map symbols and their values.
-typedef struct SymbolValuePair {
-    char symbol;
-    int value;
-} SymbolValuePair;
-
 // Map symbol pairs and their values.
 typedef struct SymbolSymbolPair {
     char lead;
@@ -28,19 +38,62 @@ typedef struct SymbolSymbolPair {
     int pairs;
 } SymbolSymbolPair;
 
+// The class of a character. For symbols, value is the lexeme value of the
+// symbol, and for pairs it is the index of the pair in pairedSymbols.
+typedef struct CharacterClass {
+    unsigned char class;
+    unsigned char value;
+} CharacterClass;
+
+// Kernels that skip runs of characters in bulk. Each takes a cursor and the
+// end of the buffer, and returns where the run stops.
+typedef struct ScannerKernels {
+    char *(*skipWhitespace)(char*, char*);
+    char *(*skipAlphanumerics)(char*, char*);
+    char *(*skipDigits)(char*, char*);
+    char *(*findStar)(char*, char*);
+} ScannerKernels;
+
+// A source file mapped into memory, and the scanner's position within it.
+typedef struct SourceBuffer {
+    char *start;
+    char *cursor;
+    char *end;
+    size_t length;
+    const ScannerKernels *kernels;
+} SourceBuffer;
+
+// Lookup tables.
+extern const CharacterClass characterClasses[CHARACTER_COUNT];
+extern const SymbolSymbolPair pairedSymbols[];
+extern const unsigned char keywordHashValues[CHARACTER_COUNT];
+extern const KeywordValuePair keywordSlots[KEYWORD_SLOTS];
+
 // Core functional prototypes.
 int scanSource(char*, char*, int);
+int scanLexemes(char*, LexemeList*, int);
+int mapSource(char*, SourceBuffer*);
+void unmapSource(SourceBuffer*);
 
 // Handler functional prototypes.
-int skipComment(FILE*);
-void eatCharacters(FILE*, int);
-int checkKeywords(FILE*, char*);
-int handleDirectMappedSymbol(FILE*, int);
-int handlePair(FILE*, FILE*, SymbolSymbolPair);
-int handleLongToken(FILE*, FILE*, char, int, int);
+int skipComment(SourceBuffer*);
+void eatCharacters(SourceBuffer*);
+int checkKeywords(LexemeList*, char*, int);
+int handleDirectMappedSymbol(LexemeList*, int);
+int handlePair(SourceBuffer*, LexemeList*, const SymbolSymbolPair*);
+int handleLongToken(SourceBuffer*, LexemeList*, int, int);
+
+// Kernel functional prototypes.
+char *skipWhitespaceScalar(char*, char*);
+char *skipAlphanumericsScalar(char*, char*);
+char *skipDigitsScalar(char*, char*);
+char *findStarScalar(char*, char*);
+int hasAVX2(void);
+int hasSSE2(void);
+const ScannerKernels *selectScannerKernels(void);
 
 // Printer functional prototypes.
 void printSource(char*);
-void printLexemeList(char*);
+void printLexemeList(LexemeList*);
 void printLexemeTableLine(char*, int);
-void printLexemeTable(char*);
+void printLexemeTable(LexemeList*);
@@ -1,6 +1,7 @@
 // Part of Plum by Tiger Sachse.
 
 #include <stdio.h>
+#include <string.h>
 #include "plum.h"
 
 // Set an option flag to true in an options int.
@@ -72,3 +73,144 @@ void setInstruction(Instruction *instruction, int opCode, int RField, int LField
     instruction->LField = LField;
     instruction->MField = MField;
 }
+
+// Check if the provided file starts with the binary bytecode magic number.
+int isBytecodeFile(char *filename) {
+    return fileStartsWith(filename, BYTECODE_MAGIC, BYTECODE_MAGIC_LENGTH);
+}
+
+// Check if a file is a binary lexeme file rather than a text one.
+int isLexemeFile(char *filename) {
+    return fileStartsWith(filename, LEXEME_MAGIC, LEXEME_MAGIC_LENGTH);
+}
+
+// Check if the first length bytes of a file match magic.
+int fileStartsWith(char *filename, char *magic, int length) {
+    FILE *f;
+    char buffer[length];
+    int matches;
+
+    if ((f = fopen(filename, "rb")) == NULL) {
+        return SIGNAL_FALSE;
+    }
+
+    matches = (fread(buffer, 1, length, f) == (size_t) length &&
+               memcmp(buffer, magic, length) == 0);
+    fclose(f);
+
+    return (matches) ? SIGNAL_TRUE : SIGNAL_FALSE;
+}
+
+// Return the flags describing bytecode written by this machine.
+int getHostBytecodeFlags(void) {
+    unsigned int probe;
+
+    probe = 1;
+
+    return (*(unsigned char*) &probe == 1) ? 0 : BYTECODE_FLAG_BIG_ENDIAN;
+}
+
+// Fold instructions into a running checksum (FNV-1a over every field).
+unsigned int checksumInstructions(unsigned int checksum,
+                                  Instruction *instructions,
+                                  int instructionCount) {
+    int i;
+    int *fields;
+
+    fields = (int*) instructions;
+    for (i = 0; i < instructionCount * 4; i++) {
+        checksum = (checksum ^ (unsigned int) fields[i]) * FNV_PRIME;
+    }
+
+    return checksum;
+}
+
+// Fold bytes into a running checksum (FNV-1a).
+unsigned int checksumBytes(unsigned int checksum, unsigned char *bytes, long length) {
+    long i;
+
+    for (i = 0; i < length; i++) {
+        checksum = (checksum ^ bytes[i]) * FNV_PRIME;
+    }
+
+    return checksum;
+}
+
+// Store a 32-bit word at bytes in little-endian order, whatever the host's order.
+void encodeWord(unsigned char *bytes, unsigned int word) {
+    bytes[0] = word & 0xFF;
+    bytes[1] = (word >> 8) & 0xFF;
+    bytes[2] = (word >> 16) & 0xFF;
+    bytes[3] = (word >> 24) & 0xFF;
+}
+
+// Read a 32-bit little-endian word stored by encodeWord().
+unsigned int decodeWord(unsigned char *bytes) {
+    return (unsigned int) bytes[0] |
+           ((unsigned int) bytes[1] << 8) |
+           ((unsigned int) bytes[2] << 16) |
+           ((unsigned int) bytes[3] << 24);
+}
+
+// Store value at bytes as a varint: seven bits per byte, low bits first, with
+// the top bit set on every byte but the last. The sign is folded into the low
+// bit first so that small negative values stay short too. Returns the number
+// of bytes used, which is at most five.
+int encodeVarint(unsigned char *bytes, int value) {
+    int length;
+    unsigned int word;
+
+    word = ((unsigned int) value << 1) ^ (unsigned int) (value < 0 ? -1 : 0);
+    for (length = 0; word >= 0x80; length++) {
+        bytes[length] = (word & 0x7F) | 0x80;
+        word >>= 7;
+    }
+    bytes[length++] = word;
+
+    return length;
+}
+
+// Read a varint stored by encodeVarint() at cursor, moving cursor past it.
+// Fails if the varint runs past end or is longer than any int.
+int decodeVarint(unsigned char **cursor, unsigned char *end, int *value) {
+    int shift;
+    unsigned int word;
+
+    word = 0;
+    for (shift = 0; shift < 35 && *cursor < end; shift += 7) {
+        word |= (unsigned int) (**cursor & 0x7F) << shift;
+        if ((*(*cursor)++ & 0x80) == 0) {
+            *value = (int) (word >> 1) ^ -(int) (word & 1);
+
+            return SIGNAL_SUCCESS;
+        }
+    }
+
+    return SIGNAL_FAILURE;
+}
+
+// Check everything about a bytecode header that doesn't need the instructions:
+// the magic number, version, byte order, and that the file holds exactly the
+// number of instructions it claims.
+int checkBytecodeHeader(BytecodeHeader *header, long fileSize, char *filename) {
+    if (header == NULL || filename == NULL) {
+        printError(ERROR_NULL_POINTER);
+
+        return SIGNAL_FAILURE;
+    }
+
+    if (fileSize < (long) sizeof(BytecodeHeader) ||
+        memcmp(header->magic, BYTECODE_MAGIC, BYTECODE_MAGIC_LENGTH) != 0 ||
+        header->version != BYTECODE_VERSION ||
+        header->flags != getHostBytecodeFlags() ||
+        header->instructionCount <= 0 ||
+        fileSize - (long) sizeof(BytecodeHeader) !=
+            (long) header->instructionCount * (long) sizeof(Instruction)) {
+
+        printError(ERROR_BAD_BYTECODE_FILE, filename);
+
+        return SIGNAL_FAILURE;
+    }
+
+    return SIGNAL_SUCCESS;
+}